@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 1998-2023 Cloud Software Group, Inc.
+ * All Rights Reserved.
+ */
+
+/*
+ * advmon - shared advisory monitor for the example tools
+ *
+ * See advmon.h for the interface description.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tibrv/tibrv.h"
+
+#include "advmon.h"
+
+#define ADVM_RING_SIZE          (256)
+#define ADVM_MAX_CLASSES        (32)
+#define ADVM_CLASS_LEN          (64)
+#define ADVM_SUBJECT_LEN        (256)
+#define ADVM_DUMP_RECENT        (10)
+#define ADVM_DEFAULT_INTERVAL   (10.0)
+
+/*
+ * One ring slot per advisory: the subject and when it arrived.  No
+ * string conversion of the advisory body on this path -- recording
+ * must stay cheap at storm rates, and the subject already carries the
+ * advisory name.
+ */
+typedef struct
+{
+    char                subject[ADVM_SUBJECT_LEN];
+    tibrvMsgDateTime    when;
+} advmRingEntry;
+
+/*
+ * Per-class counters.  The class key is the severity plus the first
+ * two elements of the advisory name, e.g. WARN.SYSTEM.DATALOSS or
+ * ERROR.RVCM.DELIVERY_FAILED, so storms aggregate by kind rather
+ * than by full subject.  Advisory class cardinality is tiny, so a
+ * linear scan of the table is fine.
+ */
+typedef struct
+{
+    char                name[ADVM_CLASS_LEN];
+    tibrv_u32           total;
+    tibrv_u32           sinceReport;
+} advmClass;
+
+/*
+ * All of this state is owned by the monitor's dispatcher thread; only
+ * advm_Stop touches it from outside, after the dispatcher has been
+ * destroyed.
+ */
+static tibrvQueue       advmQueue = TIBRV_INVALID_ID;
+static tibrvDispatcher  advmDispatcher = TIBRV_INVALID_ID;
+static tibrvEvent       advmWarnId = TIBRV_INVALID_ID;
+static tibrvEvent       advmErrorId = TIBRV_INVALID_ID;
+
+static advmRingEntry    advmRing[ADVM_RING_SIZE];
+static tibrv_u32        advmRingNext = 0;       /* next slot to write */
+static tibrv_u32        advmRingTotal = 0;      /* advisories recorded */
+
+static advmClass        advmClasses[ADVM_MAX_CLASSES];
+static tibrv_u32        advmNumClasses = 0;
+
+static tibrv_f64        advmInterval = ADVM_DEFAULT_INTERVAL;
+static tibrvMsgDateTime advmLastReport;
+
+/*
+ * Extract the class key from an advisory subject: skip the leading
+ * "_RV." and keep at most the next three dot-separated elements.
+ */
+static void
+advm_class_key(
+    const char*         subject,
+    char*               key)
+{
+    const char*         p = subject;
+    int                 dots = 0;
+    int                 n = 0;
+
+    if (strncmp(p, "_RV.", 4) == 0)
+        p += 4;
+
+    while (*p != '\0' && n < ADVM_CLASS_LEN-1)
+    {
+        if (*p == '.' && ++dots == 3)
+            break;
+        key[n++] = *p++;
+    }
+    key[n] = '\0';
+}
+
+/*
+ * Find or create the counter record for a class.  The last table slot
+ * is reserved for an OTHER bucket: once the first ADVM_MAX_CLASSES-1
+ * slots are taken, further classes aggregate there so the counts stay
+ * complete no matter how many distinct classes a storm produces.
+ */
+static advmClass*
+advm_class_lookup(
+    const char*         key)
+{
+    tibrv_u32           i;
+
+    for (i = 0; i < advmNumClasses; i++)
+    {
+        if (strcmp(advmClasses[i].name, key) == 0)
+            return (&advmClasses[i]);
+    }
+
+    if (advmNumClasses >= ADVM_MAX_CLASSES-1)
+    {
+        if (advmNumClasses == ADVM_MAX_CLASSES-1)
+        {
+            strcpy(advmClasses[advmNumClasses].name, "OTHER");
+            advmNumClasses++;
+        }
+        return (&advmClasses[ADVM_MAX_CLASSES-1]);
+    }
+
+    strcpy(advmClasses[advmNumClasses].name, key);
+    return (&advmClasses[advmNumClasses++]);
+}
+
+/*
+ * Print one summary: a line per class with activity since the last
+ * report, plus the running totals.
+ */
+static void
+advm_print_summary(void)
+{
+    tibrv_u32           i;
+
+    printf("#### ADVISORIES (last %.0f sec):\n", advmInterval);
+    for (i = 0; i < advmNumClasses; i++)
+    {
+        if (advmClasses[i].sinceReport == 0)
+            continue;
+        printf("####   %-40s %8u new %10u total\n",
+               advmClasses[i].name, advmClasses[i].sinceReport,
+               advmClasses[i].total);
+        advmClasses[i].sinceReport = 0;
+    }
+    fflush(stdout);
+}
+
+/*
+ * Advisory callback.  Record and count; print at most one summary per
+ * interval no matter how fast advisories arrive.
+ */
+static void
+advm_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    const char*         subject = NULL;
+    char                key[ADVM_CLASS_LEN];
+    advmRingEntry*      slot;
+    advmClass*          cls;
+    tibrv_f64           elapsed;
+
+    tibrvMsg_GetSendSubject(message, &subject);
+    if (subject == NULL)
+        return;
+
+    slot = &advmRing[advmRingNext];
+    advmRingNext = (advmRingNext + 1) % ADVM_RING_SIZE;
+    advmRingTotal++;
+
+    strncpy(slot->subject, subject, ADVM_SUBJECT_LEN-1);
+    slot->subject[ADVM_SUBJECT_LEN-1] = '\0';
+    tibrvMsg_GetCurrentTime(&slot->when);
+
+    advm_class_key(subject, key);
+    cls = advm_class_lookup(key);
+    cls->total++;
+    cls->sinceReport++;
+
+    elapsed = ((tibrv_f64)(slot->when.sec - advmLastReport.sec)) +
+              ((tibrv_f64)(slot->when.nsec - advmLastReport.nsec)) / 1.0e9;
+    if (elapsed >= advmInterval)
+    {
+        advm_print_summary();
+        advmLastReport = slot->when;
+    }
+}
+
+tibrv_status
+advm_Start(
+    tibrvTransport      transport,
+    tibrv_f64           summaryInterval)
+{
+    tibrv_status        err;
+
+    advmInterval = (summaryInterval > 0.0) ? summaryInterval
+                                           : ADVM_DEFAULT_INTERVAL;
+    tibrvMsg_GetCurrentTime(&advmLastReport);
+
+    err = tibrvQueue_Create(&advmQueue);
+    if (err != TIBRV_OK)
+        return (err);
+
+    err = tibrvEvent_CreateListener(&advmWarnId, advmQueue,
+                                    advm_callback, transport,
+                                    "_RV.WARN.>", NULL);
+    if (err == TIBRV_OK)
+        err = tibrvEvent_CreateListener(&advmErrorId, advmQueue,
+                                        advm_callback, transport,
+                                        "_RV.ERROR.>", NULL);
+    if (err == TIBRV_OK)
+    {
+        err = tibrvDispatcher_Create(&advmDispatcher, advmQueue);
+        if (err == TIBRV_OK)
+            tibrvDispatcher_SetName(advmDispatcher, "ADVMON");
+    }
+
+    if (err != TIBRV_OK)
+        advm_Stop();
+    return (err);
+}
+
+void
+advm_Stop(void)
+{
+    tibrv_u32           i;
+    tibrv_u32           n;
+    tibrv_u32           idx;
+
+    if (advmDispatcher != TIBRV_INVALID_ID)
+    {
+        tibrvDispatcher_Destroy(advmDispatcher);
+        advmDispatcher = TIBRV_INVALID_ID;
+    }
+    if (advmWarnId != TIBRV_INVALID_ID)
+    {
+        tibrvEvent_Destroy(advmWarnId);
+        advmWarnId = TIBRV_INVALID_ID;
+    }
+    if (advmErrorId != TIBRV_INVALID_ID)
+    {
+        tibrvEvent_Destroy(advmErrorId);
+        advmErrorId = TIBRV_INVALID_ID;
+    }
+    if (advmQueue != TIBRV_INVALID_ID)
+    {
+        tibrvQueue_Destroy(advmQueue);
+        advmQueue = TIBRV_INVALID_ID;
+    }
+
+    if (advmRingTotal == 0)
+        return;
+
+    /* The dispatcher is gone, so the state is ours to read. */
+    printf("#### ADVISORIES: %u total\n", advmRingTotal);
+    for (i = 0; i < advmNumClasses; i++)
+        printf("####   %-40s %10u total\n",
+               advmClasses[i].name, advmClasses[i].total);
+
+    n = (advmRingTotal < ADVM_DUMP_RECENT) ? advmRingTotal
+                                           : ADVM_DUMP_RECENT;
+    printf("#### most recent %u:\n", n);
+    for (i = 0; i < n; i++)
+    {
+        idx = (advmRingNext + ADVM_RING_SIZE - n + i) % ADVM_RING_SIZE;
+        printf("####   %lld.%03u %s\n",
+               (long long)advmRing[idx].when.sec,
+               (unsigned int)(advmRing[idx].when.nsec / 1000000),
+               advmRing[idx].subject);
+    }
+    fflush(stdout);
+}
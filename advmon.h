@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 1998-2023 Cloud Software Group, Inc.
+ * All Rights Reserved.
+ */
+
+/*
+ * advmon - shared advisory monitor for the example tools
+ *
+ * Several examples used to install a private advisory callback that
+ * printf'd every advisory it saw.  That collapses under an advisory
+ * storm -- a slow-consumer or dataloss event floods the queue with
+ * advisories and the printing callback falls behind exactly when
+ * visibility matters most.
+ *
+ * This component subscribes to the _RV.WARN.> and _RV.ERROR.> classes
+ * on its own queue, drained by a dedicated dispatcher thread so the
+ * flood never lands on a tool's working queues.  Each advisory is
+ * recorded cheaply: a per-class counter is bumped and the subject and
+ * arrival time go into a fixed-size ring buffer.  Summaries are
+ * emitted at most once per interval, one line per class, regardless
+ * of the advisory rate.
+ *
+ *   advm_Start     create the queue, dispatcher and listeners.
+ *
+ *   advm_Stop      destroy them and print the final per-class totals
+ *                  and the most recent advisories from the ring.
+ *
+ * All monitor state is owned by the monitor's dispatcher thread, so
+ * no locks are taken on the advisory path.
+ */
+
+#ifndef ADVMON_H
+#define ADVMON_H
+
+#include "tibrv/tibrv.h"
+
+/*
+ * Start monitoring WARN and ERROR advisories arriving on the given
+ * transport.  summaryInterval is the minimum time in seconds between
+ * printed summaries; pass 0 for the default of 10 seconds.
+ */
+extern tibrv_status
+advm_Start(
+    tibrvTransport      transport,
+    tibrv_f64           summaryInterval);
+
+/*
+ * Stop monitoring and print the final per-class totals and the most
+ * recent advisories retained in the ring.  Call before destroying the
+ * transport.
+ */
+extern void
+advm_Stop(void);
+
+#endif /* ADVMON_H */
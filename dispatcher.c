@@ -4,22 +4,26 @@
  */
 
 /*
- * dispatcher - demonstrates how to use multiple dispatcher threads.
+ * dispatcher - dispatcher thread scaling harness.
  *
  * There are no parameters required to run this program.
  *
- * The program publishes total of ten messages, two messages every second.
- * The message callback imitates lengthy processing of the
- * message by making a delay for 1 second.
- * If only one dispatcher would dispatch events it would take
- * 10 seconds to process all messages.
- * Two dispatchers accomplish processing of all messages
- * in 5 seconds because they process messages simultaneously
- * and independently.
+ * The program measures how message throughput scales with the number
+ * of dispatcher threads draining one queue.  For each thread count in
+ * the sweep it publishes a batch of messages on the intra-process
+ * transport, burns a configurable amount of simulated work per message
+ * in the callback, and reports the drain rate.  The output is a table
+ * of throughput versus thread count, so the knee for a given callback
+ * cost can be read straight off a run on the target hardware.
  *
- * Try to change the program such that it only uses one dispatcher
- * and you will see it takes much longer to process all messages.
+ * Optional parameters:
  *
+ *   dispatcher [-threads n,n,...] [-count msgs] [-work usec]
+ *
+ * where -threads lists the dispatcher pool sizes to sweep
+ * (default 1,2,4,8), -count sets the messages published per run
+ * (default 10000) and -work the simulated per-message callback work
+ * in microseconds (default 100).
  */
 
 #include <stdlib.h>
@@ -27,21 +31,26 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "tibrv/tibrv.h"
 
-char*  subject   = "dispatcher.test";   /* test subject */
-time_t startTime = 0;                   /* the time we started */
-tibrvQueue triggerQueue = TIBRV_INVALID_ID;  /* trigger queue */
-
-/* We use TIB/RV queue to emulate sleep().
- */
-tibrvQueue waitQueue = TIBRV_INVALID_ID;
+#define MAX_SWEEP          (16)     /* max entries in -threads list */
+#define MAX_THREADS        (64)
+#define DEFAULT_COUNT      (10000)
+#define DEFAULT_WORK_USEC  (100)
 
-int processedMessageCount = 0;  /* count of processed messages */
+char*  subject   = "dispatcher.test";        /* test subject */
+tibrvQueue triggerQueue = TIBRV_INVALID_ID;  /* trigger queue */
 
-#define TOTAL_MESSAGES     10   /* total number of messages, must be even */
+static unsigned int     totalMessages = DEFAULT_COUNT;
+static tibrv_f64        workSeconds = DEFAULT_WORK_USEC / 1.0e6;
 
+/* Callbacks run concurrently on the pool threads, so the processed
+ * count is guarded.
+ */
+static pthread_mutex_t  countLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int     processedMessageCount = 0;
 
 
 /*********************************************************************/
@@ -64,34 +73,55 @@ void timerCallback(tibrvEvent event, tibrvMsg msg, void* closure)
 
 
 /*********************************************************************/
-/* Message callback                                                  */
+/* Simulated per-message work: spin for the configured time.  A busy */
+/* spin models callback CPU cost; a sleep would release the core and */
+/* hide the scaling knee we are trying to find.                      */
 /*********************************************************************/
-void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
+void simulateWork(void)
 {
-    const char* msgString = NULL;
+    tibrvMsgDateTime    start;
+    tibrvMsgDateTime    now;
+    volatile tibrv_f64  sink = 0.0;
+    tibrv_f64           elapsed;
+    int                 i;
+
+    if (workSeconds <= 0.0)
+        return;
+
+    tibrvMsg_GetCurrentTime(&start);
+    for (;;)
+    {
+        for (i = 0; i < 50; i++)
+            sink += (tibrv_f64)i * 0.5;
+
+        tibrvMsg_GetCurrentTime(&now);
+        elapsed = ((tibrv_f64)(now.sec - start.sec)) +
+                  ((tibrv_f64)(now.nsec - start.nsec)) / 1.0e9;
+        if (elapsed >= workSeconds)
+            break;
+    }
+}
 
-    /* Convert the incoming message to a string */
-    tibrvMsg_ConvertToString(msg,&msgString);
 
-    /* Report we are processing the message */
-    printf("Processing message %s\n",msgString);
-    fflush(stdout);
+/*********************************************************************/
+/* Message callback                                                  */
+/*********************************************************************/
+void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
+{
+    unsigned int processed;
 
-    /* Imitate delay of one second */
-    tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)1.0);
+    /* Imitate per-message processing cost */
+    simulateWork();
 
-    /* Increase count of processed messages. In real world
-     * access to this variable should be guarded
-     * because we may be changing it from multiple
-     * dispatcher threads at the same time.
-     */
-    processedMessageCount++;
+    pthread_mutex_lock(&countLock);
+    processed = ++processedMessageCount;
+    pthread_mutex_unlock(&countLock);
 
-    /* If we have processed all messages then report it
-     * and create a timer on the trigger queue so the
-     * dispatch call on that queue returns.
+    /* If we have processed all messages then create a timer
+     * on the trigger queue so the dispatch call on that
+     * queue returns.
      */
-    if (processedMessageCount == TOTAL_MESSAGES)
+    if (processed == totalMessages)
     {
         tibrvEvent timer;  /* we don't need to keep it */
         tibrvEvent_CreateTimer(&timer,
@@ -105,37 +135,49 @@ void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
 
 
 /*********************************************************************/
-/* main                                                              */
+/* Parse a comma-separated list of thread counts.                    */
 /*********************************************************************/
-int main(int argc, char** argv)
+unsigned int parseThreadList(char* arg, unsigned int* values, unsigned int max)
 {
-    tibrv_status status;
-    tibrvQueue queue;
-    tibrvEvent listener;
-    tibrvMsg msg;
-    tibrvDispatcher dispatcher1, dispatcher2;
-    int msgIndex;
-    int i, j;
+    unsigned int n = 0;
+    char* token;
 
-    /* Open Tibrv */
-    status = tibrv_Open();
-    if (status != TIBRV_OK)
+    for (token = strtok(arg, ","); token != NULL && n < max;
+         token = strtok(NULL, ","))
     {
-        fprintf(stderr,"Error: could not open TIB/RV, status=%d, text=%s\n",
-            (int)status,tibrvStatus_GetText(status));
-        exit(-1);
+        values[n] = (unsigned int)atoi(token);
+        if (values[n] < 1)
+            values[n] = 1;
+        if (values[n] > MAX_THREADS)
+            values[n] = MAX_THREADS;
+        n++;
     }
+    return n;
+}
 
-    /* Create the queue */
-    tibrvQueue_Create(&queue);
-
-    /* Create trigger queue to wait on it */
-    tibrvQueue_Create(&triggerQueue);
-
-    /* Create wait queue */
-    tibrvQueue_Create(&waitQueue);
 
-    /* Create listener */
+/*********************************************************************/
+/* Run one configuration: publish totalMessages and drain them with  */
+/* numThreads dispatchers.  Returns the drain time in seconds.       */
+/*********************************************************************/
+tibrv_f64 runConfig(unsigned int numThreads)
+{
+    tibrvQueue queue;
+    tibrvEvent listener;
+    tibrvMsg msg;
+    tibrvDispatcher dispatchers[MAX_THREADS];
+    tibrvMsgDateTime start;
+    tibrvMsgDateTime stop;
+    char str[32];
+    unsigned int t;
+    unsigned int i;
+
+    pthread_mutex_lock(&countLock);
+    processedMessageCount = 0;
+    pthread_mutex_unlock(&countLock);
+
+    /* Create the queue and its listener */
+    tibrvQueue_Create(&queue);
     tibrvEvent_CreateListener(&listener,
                               queue,
                               (tibrvEventCallback)msgCallback,
@@ -149,70 +191,115 @@ int main(int argc, char** argv)
     tibrvMsg_Create(&msg);
     tibrvMsg_SetSendSubject(msg,subject);
 
-    /* Create two dispatchers.
-     * If you comment out creating second dispatcher
-     * you'll see it takes twice as long this example
-     * to finish.
+    tibrvMsg_GetCurrentTime(&start);
+
+    /* Publish the whole batch as fast as we can */
+    for (i=0; i<totalMessages; i++)
+    {
+        sprintf(str,"value-%u",(i+1));
+        tibrvMsg_UpdateString(msg,"field",str);
+        tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
+    }
+
+    /* Drain the queue with the pool */
+    for (t=0; t<numThreads; t++)
+        tibrvDispatcher_Create(&dispatchers[t],queue);
+
+    /* Wait until we process all messages and
+     * post an event into the trigger queue which
+     * will cause dispatch() to return.
      */
-    tibrvDispatcher_Create(&dispatcher1,queue);
-    tibrvDispatcher_Create(&dispatcher2,queue);
+    tibrvQueue_Dispatch(triggerQueue);
 
-    /* Get the start time */
-    startTime = time(0);
+    tibrvMsg_GetCurrentTime(&stop);
 
-    /* We use this to track the message number */
-    msgIndex = 0;
+    for (t=0; t<numThreads; t++)
+        tibrvDispatcher_Destroy(dispatchers[t]);
+    tibrvEvent_Destroy(listener);
+    tibrvQueue_Destroy(queue);
+    tibrvMsg_Destroy(msg);
 
-    /* Report we are starting to publish messages */
-    printf("Started publishing messages at %d seconds\n\n",
-           (int)(time(0)-startTime));
-    fflush(stdout);
+    return ((tibrv_f64)(stop.sec - start.sec)) +
+           ((tibrv_f64)(stop.nsec - start.nsec)) / 1.0e9;
+}
 
-    /* Start publishing two messages at a time
-     * every second, total of TOTAL_MESSAGES messages
-     */
-    for (i=0; i<TOTAL_MESSAGES/2; i++)
+
+/*********************************************************************/
+/* main                                                              */
+/*********************************************************************/
+int main(int argc, char** argv)
+{
+    tibrv_status status;
+    unsigned int sweep[MAX_SWEEP] = { 1, 2, 4, 8 };
+    unsigned int sweepLen = 4;
+    unsigned int workUsec = DEFAULT_WORK_USEC;
+    tibrv_f64 baseRate = 0.0;
+    unsigned int s;
+    int i;
+
+    for (i=1; i+2 <= argc && *argv[i] == '-'; i+=2)
     {
-        /* Publish 2 messages */
-        for (j=0; j<2; j++)
+        if (strcmp(argv[i], "-threads") == 0)
         {
-            char str[32];
-            msgIndex++;
-            sprintf(str,"value-%d",msgIndex);
-            tibrvMsg_UpdateString(msg,"field",str);
-            tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
+            sweepLen = parseThreadList(argv[i+1], sweep, MAX_SWEEP);
+            if (sweepLen == 0)
+            {
+                fprintf(stderr,"Error: empty -threads list\n");
+                exit(-1);
+            }
         }
-
-        /* Sleep for 1 second if we have not done publishing */
-        if (i < TOTAL_MESSAGES/2-1)
+        else if (strcmp(argv[i], "-count") == 0)
+        {
+            totalMessages = (unsigned int)atoi(argv[i+1]);
+            if (totalMessages < 1)
+                totalMessages = 1;
+        }
+        else if (strcmp(argv[i], "-work") == 0)
+        {
+            workUsec = (unsigned int)atoi(argv[i+1]);
+            workSeconds = workUsec / 1.0e6;
+        }
+        else
         {
-            tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)1.0);
+            fprintf(stderr,
+                "dispatcher [-threads n,n,...] [-count msgs] [-work usec]\n");
+            exit(-1);
         }
     }
 
-    /* Report we've published all messages */
-    printf("\nStopped publishing messages at %d seconds\n\n",
-           (int)(time(0)-startTime));
-    fflush(stdout);
+    /* Open Tibrv */
+    status = tibrv_Open();
+    if (status != TIBRV_OK)
+    {
+        fprintf(stderr,"Error: could not open TIB/RV, status=%d, text=%s\n",
+            (int)status,tibrvStatus_GetText(status));
+        exit(-1);
+    }
 
-    /* We should not quit main because that will
-     * cause the program to quit before we
-     * process all messages.
-     * Wait until we process all messages and
-     * post an event into the trigger queue which
-     * will cause dispatch() to return.
-     */
-    tibrvQueue_Dispatch(triggerQueue);
+    /* Create trigger queue to wait on it */
+    tibrvQueue_Create(&triggerQueue);
+
+    printf("%u messages per run, %u usec simulated work per message\n\n",
+           totalMessages, workUsec);
+    printf("%8s %10s %12s %8s\n",
+           "threads", "seconds", "msgs/sec", "speedup");
 
-    /* Report we have processed all messages */
-    printf("\nProcessed all messages in %d seconds\n",
-           (int)(time(0)-startTime));
-    fflush(stdout);
+    for (s=0; s<sweepLen; s++)
+    {
+        tibrv_f64 elapsed = runConfig(sweep[s]);
+        tibrv_f64 rate = (elapsed > 0.0) ? totalMessages / elapsed : 0.0;
+
+        if (s == 0)
+            baseRate = rate;
+
+        printf("%8u %10.3f %12.0f %7.2fx\n",
+               sweep[s], elapsed, rate,
+               (baseRate > 0.0) ? rate / baseRate : 0.0);
+        fflush(stdout);
+    }
 
     /* Close Tibrv */
     tibrv_Close();
 
-    tibrvMsg_Destroy(msg);
-
     return 0;
 }
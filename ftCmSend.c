@@ -43,16 +43,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#define Sleep(ms) usleep((ms)*1000)
+#endif
 
 //#include "tibrv/tibrv.h"
 //#include "tibrv/ft.h"
+#ifdef _WIN32
 #include <c:\tibco\tibrv\8.7\include\tibrv\tibrv.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\ft.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\cm.h>
+#else
+#include "tibrv/tibrv.h"
+#include "tibrv/ft.h"
+#include "tibrv/cm.h"
+#endif
+
+#include "advmon.h"
 
 #define SUBJECT "TIBRVFT_TIME"
+
+#define CM_ADV_REPORT_INTERVAL (10.0)  /* seconds between confirm summaries */
+
 char *progname;
 
+/*
+ * CM advisory state.  All of it is touched only from the CM advisory
+ * dispatcher thread, so no locking is needed.
+ */
+static tibrvQueue       cmAdvQueue;
+static tibrvDispatcher  cmAdvDispatcher;
+static tibrv_u32        confirmTotal = 0;
+static tibrv_u32        confirmBatch = 0;
+static tibrv_u64        lastConfirmSeqno = 0;
+static tibrvMsgDateTime lastConfirmReport;
+
 //tibrvcmTransport    cmtransport;
 //tibrvMsg            send_message;
 //tibrv_u32           current_round;
@@ -130,6 +158,58 @@ advCB(tibrvEvent        event,
 } /* advCB  */
 
 
+/*
+ * CM advisory callback.  Runs on its own queue with a dedicated
+ * dispatcher thread, so bursts of DELIVERY.CONFIRM advisories never
+ * delay pubTime or the FT instruction path on the default queue.
+ * Confirmations are only counted here; a summary line is printed at
+ * most once per CM_ADV_REPORT_INTERVAL seconds.  Other CM advisories
+ * are rare and still printed as they arrive.
+ */
+
+static void
+cmAdvCB(tibrvEvent      event,
+        tibrvMsg        message,
+        void *          closure)
+{
+    tibrv_status        err;
+    const char          *string;
+    const char          *name;
+    tibrvMsgDateTime    now;
+
+    err = tibrvMsg_GetSendSubject(message, &name);
+    if (err != TIBRV_OK)
+        return;
+
+    if (strstr(name, "DELIVERY.CONFIRM") != NULL)
+    {
+        confirmTotal++;
+        confirmBatch++;
+        tibrvMsg_GetU64(message, "seqno", &lastConfirmSeqno);
+
+        tibrvMsg_GetCurrentTime(&now);
+        if ((tibrv_f64)(now.sec - lastConfirmReport.sec) >=
+            CM_ADV_REPORT_INTERVAL)
+        {
+            fprintf(stderr,
+                    "#### RVCM CONFIRM: %u since last report, %u total, last seqno %llu\n",
+                    confirmBatch, confirmTotal,
+                    (unsigned long long)lastConfirmSeqno);
+            confirmBatch = 0;
+            lastConfirmReport = now;
+        }
+        return;
+    }
+
+    tibrvMsg_ConvertToString(message, &string);
+    fprintf(stderr,
+            "#### RVCM ADVISORY: %s \nAdvisory message is: %s\n",
+            name, string);
+
+    return;
+} /* cmAdvCB  */
+
+
 /*
  * Timer callback called every 10 seconds.  Publish time if active.
  */
@@ -449,6 +529,7 @@ main(int argc, char **argv)
     //tibrv_f64           cmtimeNum = 0;
 
     tibrvEvent          advId;
+    tibrvEvent          cmAdvId;
 
     /*
      * Warn user - RVFT initialization takes one activation interval.
@@ -584,15 +665,6 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f \n",
                 "_RV.*.RVFT.*.>",
                 &data);
 
-     err = tibrvEvent_CreateListener(
-                &advId,
-                TIBRV_DEFAULT_QUEUE,
-                advCB,
-                data.fttransport,
-                //"_RV.*.RVFT.*.TIBRVFT_TIME_EXAMPLE",
-                "_RV.*.RVCM.*.>",
-                &data);
-
     if(err != TIBRV_OK)
     {
         fprintf(stderr,"%s: Failed to start listening to advisories - %s\n",
@@ -600,6 +672,51 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f \n",
         exit(5);
     }
 
+    /*
+     * CM advisories (DELIVERY.CONFIRM bursts in particular) go to
+     * their own queue with a dedicated dispatcher thread.  The default
+     * queue then carries only the publish timer and FT instructions,
+     * so the active sender's cadence stays flat while confirmations
+     * are absorbed asynchronously.
+     */
+
+    err = tibrvQueue_Create(&cmAdvQueue);
+    if (err == TIBRV_OK)
+        err = tibrvEvent_CreateListener(
+                    &cmAdvId,
+                    cmAdvQueue,
+                    cmAdvCB,
+                    data.transport,     /* CM advisories arrive here */
+                    "_RV.*.RVCM.*.>",
+                    &data);
+    if (err == TIBRV_OK)
+    {
+        tibrvMsg_GetCurrentTime(&lastConfirmReport);
+        err = tibrvDispatcher_Create(&cmAdvDispatcher, cmAdvQueue);
+    }
+    if (err == TIBRV_OK)
+        tibrvDispatcher_SetName(cmAdvDispatcher, "CMADV");
+
+    if(err != TIBRV_OK)
+    {
+        fprintf(stderr,"%s: Failed to start CM advisory dispatcher - %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(5);
+    }
+
+    /*
+     * The shared advisory monitor absorbs WARN/ERROR storms (slow
+     * consumer, dataloss) on its own thread.  The RVFT listener above
+     * still prints each FT instruction immediately -- those are
+     * low-rate and drive the member state machine.
+     */
+    err = advm_Start(data.transport, 0);
+    if(err != TIBRV_OK)
+    {
+        fprintf(stderr,"%s: Failed to start advisory monitor - %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(5);
+    }
 
     /*
      * Dispatch loop - dispatches events which have been placed on the event queue
@@ -615,6 +732,10 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f \n",
      */
 
     tibrvEvent_Destroy(advId);
+    tibrvEvent_Destroy(cmAdvId);
+    advm_Stop();
+    tibrvDispatcher_Destroy(cmAdvDispatcher);
+    tibrvQueue_Destroy(cmAdvQueue);
     tibrvEvent_Destroy(data.timerId);
     tibrvftMember_Destroy(data.groupId);
 
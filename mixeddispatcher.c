@@ -4,21 +4,28 @@
  */
 
 /*
- * mixeddispatcher - demonstrates how to use multiple dispatcher threads.
+ * mixeddispatcher - demonstrates a hybrid event loop: a main thread
+ *                   draining a light queue with zero-timeout polls
+ *                   interleaved with application idle work, backed by
+ *                   dispatcher threads for heavy callbacks.
  *
  * There are no parameters required to run this program.
  *
- * The program publishes total of ten messages, two messages every second.
- * However there are two listeners for the same subject so there will be
- * two  messages dispatched for each published message
- * The message callback imitates lengthy processing of the
- * message by making a delay for 1 second.
- * If only one dispatcher would dispatch events it would take
- * 10 seconds to process all messages.
- * Two dispatchers accomplish processing of all messages
- * in 5 seconds because they process messages simultaneously
- * and independently.
+ * The program publishes a total of ten messages, two messages every
+ * second.  Two listeners receive each message: a simple callback on
+ * the light queue, handled inline by the main loop, and a vector
+ * callback on the heavy queue, handled by two dispatcher threads so
+ * its one-second processing delay never blocks the main loop.
  *
+ * The main loop is the pattern for embedding RV into an existing
+ * application loop: poll the light queue with a zero timeout (no
+ * fixed per-dispatch wait), run a slice of application work, and only
+ * when both the poll missed and the application had nothing to do,
+ * back off briefly.  A fixed-timeout dispatch call would add that
+ * timeout as pure latency on every quiet iteration.
+ *
+ * The loop instruments itself: poll hit rate (polls that dispatched
+ * an event) and idle-slice duration are reported at the end.
  */
 
 #include <stdlib.h>
@@ -26,41 +33,39 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "tibrv/tibrv.h"
 
 char*  subject   = "dispatcher.test";   /* test subject */
 
 time_t startTime = 0;                   /* the time we started */
-tibrvQueue triggerQueue = TIBRV_INVALID_ID;  /* trigger queue */
 
 /* We use TIB/RV queue to emulate sleep().
  */
 tibrvQueue waitQueue = TIBRV_INVALID_ID;
 
-int processedMessageCount = 0;  /* count of processed messages */
-
 #define TOTAL_MESSAGES     10   /* total number of messages, must be even */
 
+/* The light count is owned by the main thread - only the hybrid loop
+ * dispatches the light queue.  The heavy count is updated from the
+ * dispatcher threads and is guarded.
+ */
+static int              lightProcessedCount = 0;
+static pthread_mutex_t  heavyLock = PTHREAD_MUTEX_INITIALIZER;
+static int              heavyProcessedCount = 0;
+
+/* Hybrid loop instrumentation */
+static unsigned long    pollCount = 0;
+static unsigned long    pollHits = 0;
+static tibrv_f64        idleTotal = 0.0;    /* idle-slice time, seconds */
+static tibrv_f64        idleMax = 0.0;
+static unsigned long    idleSlices = 0;
 
 
 /*********************************************************************/
-/* Timer callback                                                    */
+/* Vector callback - the heavy path, drained by dispatcher threads   */
 /*********************************************************************/
-void timerCallback(tibrvEvent event, tibrvMsg msg, void* closure)
-{
-    /* avoid warning "parameter not used" */
-    (void)msg;
-    (void)closure;
-
-    /* Trigger timer only needed for the dispatch()
-     * call on the trigger queue to return.
-     * We simply destroy the event so it won't
-     * keep firing since it has 0 interval.
-     * Nothing else should be done here.
-     */
-    tibrvEvent_Destroy(event);
-}
 void vectorCallback(tibrvMsg msgs[], tibrv_u32 size)
 {
     const char* msgString = NULL;
@@ -71,38 +76,21 @@ void vectorCallback(tibrvMsg msgs[], tibrv_u32 size)
         tibrvMsg_ConvertToString(msgs[i],&msgString);
 
         /* Report we are processing the message */
-        printf("Vector callback processing message %s\n",msgString);
+        printf("Heavy callback processing message %s\n",msgString);
         fflush(stdout);
 
         /* Imitate delay of one second */
         tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)1.0);
 
-        /* Increase count of processed messages. In real world
-         * access to this variable should be guarded
-         * because we may be changing it from multiple
-         * dispatcher threads at the same time.
-         */
-        processedMessageCount++;
-
-        /* If we have processed all messages then report it
-         * and create a timer on the trigger queue so the
-         * dispatch call on that queue returns.
-         */
-        if (processedMessageCount == TOTAL_MESSAGES*2)
-        {
-            tibrvEvent timer;  /* we don't need to keep it */
-            tibrvEvent_CreateTimer(&timer,
-                                   triggerQueue,
-                                   (tibrvEventCallback)timerCallback,
-                                   (tibrv_f64)0, /* no delay */
-                                   NULL);
-        }
+        pthread_mutex_lock(&heavyLock);
+        heavyProcessedCount++;
+        pthread_mutex_unlock(&heavyLock);
     }
 
 }
 
 /*********************************************************************/
-/* Message callback                                                  */
+/* Message callback - the light path, run inline by the main loop    */
 /*********************************************************************/
 void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
 {
@@ -112,33 +100,52 @@ void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
     tibrvMsg_ConvertToString(msg,&msgString);
 
     /* Report we are processing the message */
-    printf("Simple callback processing message %s\n",msgString);
+    printf("Light callback processing message %s\n",msgString);
     fflush(stdout);
 
-    /* Imitate delay of one second */
-    tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)1.0);
-
-    /* Increase count of processed messages. In real world
-     * access to this variable should be guarded
-     * because we may be changing it from multiple
-     * dispatcher threads at the same time.
+    /* Light work completes inline; no simulated delay here, the
+     * main loop must stay responsive.
      */
-    processedMessageCount++;
+    lightProcessedCount++;
 
-    /* If we have processed all messages then report it
-     * and create a timer on the trigger queue so the
-     * dispatch call on that queue returns.
-     */
-    if (processedMessageCount == TOTAL_MESSAGES*2)
+}
+
+
+/*********************************************************************/
+/* Application idle work: the paced publisher.  Returns 1 if it did  */
+/* something, 0 if there was nothing to do this slice.               */
+/*********************************************************************/
+int appIdleWork(void)
+{
+    static int msgIndex = 0;
+    static time_t lastPublish = 0;
+    static tibrvMsg msg = NULL;
+    char str[32];
+    int j;
+
+    if (msgIndex >= TOTAL_MESSAGES)
+        return 0;
+
+    /* Publish two messages every second */
+    if (lastPublish != 0 && time(0) - lastPublish < 1)
+        return 0;
+
+    if (msg == NULL)
+    {
+        tibrvMsg_Create(&msg);
+        tibrvMsg_SetSendSubject(msg,subject);
+    }
+
+    for (j=0; j<2; j++)
     {
-        tibrvEvent timer;  /* we don't need to keep it */
-        tibrvEvent_CreateTimer(&timer,
-                               triggerQueue,
-                               (tibrvEventCallback)timerCallback,
-                               (tibrv_f64)0, /* no delay */
-                               NULL);
+        msgIndex++;
+        sprintf(str,"value-%d",msgIndex);
+        tibrvMsg_UpdateString(msg,"field",str);
+        tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
     }
+    lastPublish = time(0);
 
+    return 1;
 }
 
 
@@ -148,12 +155,14 @@ void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
 int main(int argc, char** argv)
 {
     tibrv_status status;
-    tibrvQueue queue;
+    tibrvQueue lightQueue, heavyQueue;
     tibrvEvent listener,vectorlistener;
-    tibrvMsg msg;
     tibrvDispatcher dispatcher1, dispatcher2;
-    int msgIndex;
-    int i, j;
+    tibrvMsgDateTime sliceStart, sliceStop;
+    tibrv_f64 slice;
+    int heavyDone;
+    int didWork;
+    int hit;
 
     /* Open Tibrv */
     status = tibrv_Open();
@@ -164,18 +173,18 @@ int main(int argc, char** argv)
         exit(-1);
     }
 
-    /* Create the queue */
-    tibrvQueue_Create(&queue);
+    /* Create the light queue, drained only by the main loop */
+    tibrvQueue_Create(&lightQueue);
 
-    /* Create trigger queue to wait on it */
-    tibrvQueue_Create(&triggerQueue);
+    /* Create the heavy queue, drained by the dispatcher pool */
+    tibrvQueue_Create(&heavyQueue);
 
     /* Create wait queue */
     tibrvQueue_Create(&waitQueue);
 
     /* Create listeners */
     tibrvEvent_CreateListener(&listener,
-                              queue,
+                              lightQueue,
                               (tibrvEventCallback)msgCallback,
                               TIBRV_PROCESS_TRANSPORT,
                               subject,
@@ -183,82 +192,75 @@ int main(int argc, char** argv)
 
     /* Create listeners */
     tibrvEvent_CreateVectorListener(&vectorlistener,
-                              queue,
+                              heavyQueue,
                               vectorCallback,
                               TIBRV_PROCESS_TRANSPORT,
                               subject,
                               NULL);
 
-    /* Prepare the message we'll be sending and
-     * set the send subject into it
-     */
-    tibrvMsg_Create(&msg);
-    tibrvMsg_SetSendSubject(msg,subject);
-
-    /* Create two dispatchers.
-     * If you comment out creating second dispatcher
-     * you'll see it takes twice as long this example
-     * to finish.
+    /* Two dispatchers drain the heavy queue so its long callbacks
+     * overlap and never involve the main thread.
      */
-    tibrvDispatcher_Create(&dispatcher1,queue);
-    tibrvDispatcher_Create(&dispatcher2,queue);
+    tibrvDispatcher_Create(&dispatcher1,heavyQueue);
+    tibrvDispatcher_Create(&dispatcher2,heavyQueue);
 
     /* Get the start time */
     startTime = time(0);
 
-    /* We use this to track the message number */
-    msgIndex = 0;
-
-    /* Report we are starting to publish messages */
-    printf("Started publishing messages at %d seconds\n\n",
+    printf("Started hybrid loop at %d seconds\n\n",
            (int)(time(0)-startTime));
     fflush(stdout);
 
-    /* Start publishing two messages at a time
-     * every second, total of TOTAL_MESSAGES messages
+    /* The hybrid loop.  Each iteration: one zero-timeout poll of the
+     * light queue, one slice of application work, and a short backoff
+     * only when both found nothing.
      */
-    for (i=0; i<TOTAL_MESSAGES/2; i++)
+    for (;;)
     {
-        /* Publish 2 messages */
-        for (j=0; j<2; j++)
-        {
-            char str[32];
-            msgIndex++;
-            sprintf(str,"value-%d",msgIndex);
-            tibrvMsg_UpdateString(msg,"field",str);
-            tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
-        }
-
-        /* Sleep for 1 second if we have not done publishing */
-        if (i < TOTAL_MESSAGES/2-1)
-        {
-            tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)1.0);
-        }
+        pollCount++;
+        hit = (tibrvQueue_TimedDispatch(lightQueue,(tibrv_f64)0.0)
+                   == TIBRV_OK);
+        if (hit)
+            pollHits++;
+
+        tibrvMsg_GetCurrentTime(&sliceStart);
+        didWork = appIdleWork();
+        tibrvMsg_GetCurrentTime(&sliceStop);
+
+        slice = ((tibrv_f64)(sliceStop.sec - sliceStart.sec)) +
+                ((tibrv_f64)(sliceStop.nsec - sliceStart.nsec)) / 1.0e9;
+        idleSlices++;
+        idleTotal += slice;
+        if (slice > idleMax)
+            idleMax = slice;
+
+        pthread_mutex_lock(&heavyLock);
+        heavyDone = heavyProcessedCount;
+        pthread_mutex_unlock(&heavyLock);
+
+        if (lightProcessedCount == TOTAL_MESSAGES &&
+            heavyDone == TOTAL_MESSAGES)
+            break;
+
+        /* Back off only when fully idle; a busy loop stays hot. */
+        if (!hit && !didWork)
+            tibrvQueue_TimedDispatch(waitQueue,(tibrv_f64)0.001);
     }
 
-    /* Report we've published all messages */
-    printf("\nStopped publishing messages at %d seconds\n\n",
-           (int)(time(0)-startTime));
-    fflush(stdout);
-
-    /* We should not quit main because that will
-     * cause the program to quit before we
-     * process all messages.
-     * Wait until we process all messages and
-     * post an event into the trigger queue which
-     * will cause dispatch() to return.
-     */
-    tibrvQueue_Dispatch(triggerQueue);
-
     /* Report we have processed all messages */
     printf("\nProcessed all messages in %d seconds\n",
            (int)(time(0)-startTime));
+    printf("polls: %lu, hits: %lu (%.1f%%)\n",
+           pollCount, pollHits,
+           (pollCount > 0) ? (100.0 * pollHits) / pollCount : 0.0);
+    printf("idle slices: %lu, avg %.1f usec, max %.1f usec\n",
+           idleSlices,
+           (idleSlices > 0) ? (idleTotal / idleSlices) * 1.0e6 : 0.0,
+           idleMax * 1.0e6);
     fflush(stdout);
 
     /* Close Tibrv */
     tibrv_Close();
 
-    tibrvMsg_Destroy(msg);
-
     return 0;
 }
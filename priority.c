@@ -4,17 +4,33 @@
  */
 
 /*
- * priority - demonstrating queues, groups and priorities.
+ * priority - demonstrating queues, groups, priorities and a
+ *            dispatcher pool.
  *
  * There are no parameters required to run this program.
  *
- * This sample creates two queues with different priorities, creates
- * a queue group containing those queues, then publishes messages
- * to two listeners. After messages have been published the program
- * dispatches the queue group until there are no events in the group.
- * Because queues have different priorities the callback will first
- * receive messages published into the queue with higher priority.
+ * This sample creates two queues with different priorities (a
+ * high-priority "control" queue and a low-priority "bulk" queue),
+ * creates a queue group containing those queues, publishes messages
+ * to listeners on both queues, then drains the group with a pool of
+ * dispatcher threads.
  *
+ * Because the group serves its highest-priority non-empty queue
+ * first, control messages preempt bulk messages; and because every
+ * pool thread dispatches the whole group rather than one pinned
+ * queue, a thread that finds the control queue empty immediately
+ * steals work from the bulk queue instead of idling.
+ *
+ * Each queue keeps gauges - events served, service latency (publish
+ * to callback) and the deepest backlog observed - printed as a
+ * per-queue report once the group is drained.
+ *
+ * Optional parameters:
+ *
+ *   priority [-threads n] [-count n]
+ *
+ * where -threads sets the dispatcher pool size (default 2) and
+ * -count the number of messages published per queue (default 10).
  */
 
 #include <stdlib.h>
@@ -22,30 +38,90 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "tibrv/tibrv.h"
 
+#define MAX_THREADS     (16)
+
 char* subject1 = "1";
 char* subject2 = "2";
 
+/*********************************************************************/
+/* Per-queue gauges.  Events from one queue may be in flight on      */
+/* several pool threads at once, so updates take the queue's lock.   */
+/*********************************************************************/
+typedef struct queueInfo
+{
+    tibrvQueue          queue;
+    const char*         name;
+    pthread_mutex_t     lock;
+    tibrv_u32           served;
+    tibrv_f64           latencyTotal;   /* publish-to-callback, seconds */
+    tibrv_f64           latencyMax;
+    tibrv_u32           maxDepth;
+} queueInfo;
+
+static queueInfo    controlInfo;
+static queueInfo    bulkInfo;
+static int          verbose = 1;
+
 /*********************************************************************/
 /* Message callback class                                            */
 /*********************************************************************/
 void msgCallback(tibrvEvent event, tibrvMsg msg, void* closure)
 {
-    const char* sendSubject  = NULL;
-    const char* msgString    = NULL;
+    queueInfo*          info = (queueInfo*) closure;
+    const char*         sendSubject  = NULL;
+    const char*         msgString    = NULL;
+    tibrvMsgDateTime    sent;
+    tibrvMsgDateTime    now;
+    tibrv_f64           latency = 0.0;
+    tibrv_u32           depth = 0;
 
-    /* Get the subject name to which this message was sent */
-    tibrvMsg_GetSendSubject(msg,&sendSubject);
+    tibrvMsg_GetCurrentTime(&now);
+    if (tibrvMsg_GetDateTime(msg, "sent", &sent) == TIBRV_OK)
+        latency = ((tibrv_f64)(now.sec - sent.sec)) +
+                  ((tibrv_f64)(now.nsec - sent.nsec)) / 1.0e9;
 
-    /* Convert the incoming message to a string */
-    tibrvMsg_ConvertToString(msg,&msgString);
+    tibrvQueue_GetCount(info->queue, &depth);
 
-    printf("Received message on subject %s: %s\n",
-               sendSubject, msgString);
+    pthread_mutex_lock(&info->lock);
+    info->served++;
+    info->latencyTotal += latency;
+    if (latency > info->latencyMax)
+        info->latencyMax = latency;
+    if (depth > info->maxDepth)
+        info->maxDepth = depth;
+    pthread_mutex_unlock(&info->lock);
 
-    fflush(stdout);
+    if (verbose)
+    {
+        /* Get the subject name to which this message was sent */
+        tibrvMsg_GetSendSubject(msg,&sendSubject);
+
+        /* Convert the incoming message to a string */
+        tibrvMsg_ConvertToString(msg,&msgString);
+
+        printf("Received message on subject %s: %s\n",
+                   sendSubject, msgString);
+
+        fflush(stdout);
+    }
+}
+
+/*********************************************************************/
+/* Report the gauges for one queue.                                  */
+/*********************************************************************/
+void reportQueue(queueInfo* info)
+{
+    printf("%s queue: %u served, latency avg %.1f usec, max %.1f usec, "
+           "max depth %u\n",
+           info->name, info->served,
+           (info->served > 0) ?
+               (info->latencyTotal / info->served) * 1.0e6 : 0.0,
+           info->latencyMax * 1.0e6,
+           info->maxDepth);
 }
 
 /*********************************************************************/
@@ -55,11 +131,45 @@ int main(int argc, char** argv)
 {
     tibrv_status status;
     tibrvQueue queue1, queue2;
+    tibrvQueue waitQueue;
     tibrvQueueGroup group;
     tibrvEvent listener1, listener2;
+    tibrvDispatcher dispatchers[MAX_THREADS];
     tibrvMsg msg;
+    tibrvMsgDateTime now;
     char valstr[32];
-    int i;
+    char threadName[16];
+    unsigned int numThreads = 2;
+    unsigned int count = 10;
+    unsigned int t;
+    unsigned int i;
+
+    for (i = 1; i + 2 <= (unsigned int)argc && *argv[i] == '-'; i += 2)
+    {
+        if (strcmp(argv[i], "-threads") == 0)
+        {
+            numThreads = (unsigned int)atoi(argv[i+1]);
+            if (numThreads < 1)
+                numThreads = 1;
+            if (numThreads > MAX_THREADS)
+                numThreads = MAX_THREADS;
+        }
+        else if (strcmp(argv[i], "-count") == 0)
+        {
+            count = (unsigned int)atoi(argv[i+1]);
+            if (count < 1)
+                count = 1;
+        }
+        else
+        {
+            fprintf(stderr, "priority [-threads n] [-count n]\n");
+            exit(-1);
+        }
+    }
+
+    /* Per-message output would swamp a large run */
+    if (count > 20)
+        verbose = 0;
 
     /* Open Tibrv */
     status = tibrv_Open();
@@ -74,10 +184,18 @@ int main(int argc, char** argv)
     tibrvQueue_Create(&queue1);
     tibrvQueue_Create(&queue2);
 
-    /* Set priorities */
+    /* Set priorities - the group always serves the highest-priority
+     * non-empty queue, so queue2 (control) preempts queue1 (bulk). */
     tibrvQueue_SetPriority(queue1,1);
     tibrvQueue_SetPriority(queue2,2);
 
+    bulkInfo.queue = queue1;
+    bulkInfo.name = "bulk";
+    pthread_mutex_init(&bulkInfo.lock, NULL);
+    controlInfo.queue = queue2;
+    controlInfo.name = "control";
+    pthread_mutex_init(&controlInfo.lock, NULL);
+
     /* Create queue group and add queues */
     tibrvQueueGroup_Create(&group);
     tibrvQueueGroup_Add(group,queue1);
@@ -89,40 +207,85 @@ int main(int argc, char** argv)
                               (tibrvEventCallback)msgCallback,
                               TIBRV_PROCESS_TRANSPORT,
                               subject1,
-                              NULL);
+                              &bulkInfo);
     tibrvEvent_CreateListener(&listener2,
                               queue2,
                               (tibrvEventCallback)msgCallback,
                               TIBRV_PROCESS_TRANSPORT,
                               subject2,
-                              NULL);
+                              &controlInfo);
 
     /* Create tibrvMsg we'll be sending */
     tibrvMsg_Create(&msg);
 
-    /* Send 10 messages on subject1 */
+    /* Send bulk messages on subject1 */
     tibrvMsg_SetSendSubject(msg,subject1);
-    for (i=0; i<10; i++)
+    for (i=0; i<count; i++)
     {
         sprintf(valstr,"value-1-%d",(i+1));
         tibrvMsg_UpdateString(msg,"field",valstr);
+        tibrvMsg_GetCurrentTime(&now);
+        tibrvMsg_UpdateDateTime(msg,"sent",&now);
         tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
     }
 
-    /* Send 10 messages on subject1 */
+    /* Send control messages on subject2 */
     tibrvMsg_SetSendSubject(msg,subject2);
-    for (i=0; i<10; i++)
+    for (i=0; i<count; i++)
     {
         sprintf(valstr,"value-2-%d",(i+1));
         tibrvMsg_UpdateString(msg,"field",valstr);
+        tibrvMsg_GetCurrentTime(&now);
+        tibrvMsg_UpdateDateTime(msg,"sent",&now);
         tibrvTransport_Send(TIBRV_PROCESS_TRANSPORT,msg);
     }
 
-    /* Dispatch the group. When all events are
-     * dispatched timedDispatch() will return
-     * TIBRV_TIMEOUT so we'll break out the while() loop.
+    /* Drain the group with a pool of dispatcher threads.  Each
+     * thread dispatches the whole group: control events are served
+     * first, and any thread finding the control queue empty steals
+     * from the bulk queue rather than sitting idle.
      */
-    while (tibrvQueueGroup_TimedDispatch(group,1) == TIBRV_OK);
+    for (t = 0; t < numThreads; t++)
+    {
+        status = tibrvDispatcher_Create(&dispatchers[t], group);
+        if (status != TIBRV_OK)
+        {
+            fprintf(stderr,
+                "Error: could not create dispatcher, status=%d, text=%s\n",
+                (int)status,tibrvStatus_GetText(status));
+            exit(-1);
+        }
+        sprintf(threadName, "POOL-%u", t);
+        tibrvDispatcher_SetName(dispatchers[t], threadName);
+    }
+
+    /* Wait until the pool has served everything.  Stall on an empty
+     * queue so the wait does not burn a core.
+     */
+    tibrvQueue_Create(&waitQueue);
+    for (;;)
+    {
+        tibrv_u32 served;
+
+        pthread_mutex_lock(&bulkInfo.lock);
+        pthread_mutex_lock(&controlInfo.lock);
+        served = bulkInfo.served + controlInfo.served;
+        pthread_mutex_unlock(&controlInfo.lock);
+        pthread_mutex_unlock(&bulkInfo.lock);
+
+        if (served >= 2 * count)
+            break;
+
+        tibrvQueue_TimedDispatch(waitQueue, 0.01);
+    }
+
+    for (t = 0; t < numThreads; t++)
+        tibrvDispatcher_Destroy(dispatchers[t]);
+
+    printf("dispatcher pool: %u thread(s)\n", numThreads);
+    reportQueue(&controlInfo);
+    reportQueue(&bulkInfo);
+    fflush(stdout);
 
     /* Close Tibrv */
     tibrv_Close();
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 1998-2023 Cloud Software Group, Inc.
+ * All Rights Reserved.
+ */
+
+/*
+ * rvbench - paired latency/throughput benchmark
+ *
+ * This program measures Rendezvous request/reply performance between
+ * two processes.  One process runs as the reflector and echoes every
+ * request back to its sender; the other runs as the sender, sweeping
+ * payload sizes and send rates and reporting one CSV row per
+ * configuration with msgs/sec, MB/sec and round-trip latency
+ * percentiles.  The first messages of each configuration are treated
+ * as warm-up and excluded from the statistics.
+ *
+ * The sender addresses the reflector with the inbox request/reply
+ * pattern used by tibrvclient and tibrvserver: each request carries a
+ * payload and is answered point-to-point.
+ *
+ * Optionally the user may specify communication parameters for
+ * tibrvTransport_Create.  If none are specified, default values are
+ * used.  For information on default values for these parameters,
+ * please see the TIBCO/Rendezvous Concepts manual.
+ *
+ * Examples:
+ *
+ *  Start a reflector:
+ *   rvbench -reflect
+ *
+ *  Sweep 64 byte to 8K payloads, 5000 round trips each, at full speed:
+ *   rvbench -sizes 64,1024,8192 -count 5000
+ *
+ *  The same sweep paced at 1000 and 5000 msgs/sec:
+ *   rvbench -sizes 64,1024,8192 -rates 1000,5000 -count 5000
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tibrv/tibrv.h"
+
+#include "rvutil.h"
+
+#define BENCH_SUBJECT       "RVBENCH.PING"  /* Senders address requests
+                                               to this subject; replies
+                                               return point-to-point. */
+
+#define MAX_SWEEP           (16)        /* sizes/rates per sweep list  */
+
+#define DEFAULT_COUNT       (10000)     /* round trips per config      */
+#define DEFAULT_WARMUP      (1000)      /* untimed round trips         */
+
+#define REQUEST_TIMEOUT     (10.0)      /* give up on a lost reply     */
+
+#define FIELD_NAME          "DATA"
+
+static char*                progname;
+
+/* Round-trip latencies are accumulated per configuration in the
+   shared rvutil log-linear histogram. */
+static rvuHist              latency_hist;
+
+void
+usage(void)
+{
+    fprintf(stderr,"rvbench  [-service service] [-network network]\n");
+    fprintf(stderr,"         [-daemon daemon]\n");
+    fprintf(stderr,"         -reflect                    reflector role, or:\n");
+    fprintf(stderr,"         [-sizes bytes,bytes,...]    payload sweep (default 64)\n");
+    fprintf(stderr,"         [-rates msgs/sec,...]       rate sweep, 0 = full speed\n");
+    fprintf(stderr,"                                     (default 0)\n");
+    fprintf(stderr,"         [-count #roundtrips]        per config (default %d)\n",
+            DEFAULT_COUNT);
+    fprintf(stderr,"         [-warmup #roundtrips]       excluded (default %d)\n",
+            DEFAULT_WARMUP);
+    exit(1);
+}
+
+/*
+ * Parse a comma separated list of unsigned values into a sweep array.
+ * Returns the number of values parsed.
+ */
+static int
+parse_sweep_list(
+    char*       arg,
+    tibrv_u32*  values,
+    int         max_values)
+{
+    int         count = 0;
+    char*       token;
+
+    for (token = strtok(arg, ","); token != NULL;
+         token = strtok(NULL, ","))
+    {
+        if (count >= max_values)
+        {
+            fprintf(stderr, "%s: Too many sweep values (max %d)\n",
+                    progname, max_values);
+            exit(1);
+        }
+        values[count++] = (tibrv_u32)strtoul(token, NULL, 10);
+    }
+
+    if (count == 0)
+        usage();
+    return count;
+}
+
+static tibrvTransport   reflect_transport;
+
+/*
+ * Reflector callback: echo every request straight back to its sender.
+ * The reply travels point-to-point to the requesting inbox.
+ */
+void
+reflect_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    tibrv_status        err;
+
+    err = tibrvTransport_SendReply(reflect_transport, message, message);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to send reply: %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+}
+
+/*
+ * Run the reflector role: listen on the benchmark subject and echo
+ * until killed.
+ */
+void
+run_reflector(
+    tibrvTransport      transport)
+{
+    tibrv_status        err;
+    tibrvEvent          listenId;
+
+    reflect_transport = transport;
+
+    err = tibrvEvent_CreateListener(&listenId, TIBRV_DEFAULT_QUEUE,
+                                    reflect_callback, transport,
+                                    BENCH_SUBJECT, NULL);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Error %s listening to \"%s\"\n",
+                progname, tibrvStatus_GetText(err), BENCH_SUBJECT);
+        exit(1);
+    }
+
+    printf("%s: reflecting on subject %s\n", progname, BENCH_SUBJECT);
+    fflush(stdout);
+
+    while (tibrvQueue_Dispatch(TIBRV_DEFAULT_QUEUE) == TIBRV_OK);
+}
+
+/*
+ * Run one sweep configuration: count round trips of msgSize bytes at
+ * the given rate (0 = full speed), the first warmup of them untimed.
+ * Emits one CSV row on success.
+ */
+void
+run_config(
+    tibrvTransport      transport,
+    tibrv_u32           msgSize,
+    tibrv_u32           rate,
+    tibrv_u32           count,
+    tibrv_u32           warmup)
+{
+    tibrv_status        err;
+    tibrvMsg            request;
+    tibrvMsg            reply;
+    rvuPacer            pacer;
+    char*               payload;
+    tibrvMsgDateTime    sendTime;
+    tibrvMsgDateTime    recvTime;
+    tibrvMsgDateTime    measureStart;
+    tibrv_f64           elapsed;
+    tibrv_u32           measured = 0;
+    tibrv_u32           i;
+
+    rvu_HistReset(&latency_hist);
+
+    /* Build the request once; the loop measures transport cost, not
+       message construction. */
+    err = tibrvMsg_Create(&request);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to create message: %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+
+    payload = (char*)calloc(1, msgSize > 0 ? msgSize : 1);
+    if (payload == NULL)
+    {
+        fprintf(stderr, "%s: Failed to allocate %u byte payload\n",
+                progname, msgSize);
+        exit(1);
+    }
+
+    err = tibrvMsg_AddOpaque(request, FIELD_NAME, payload, msgSize);
+    if (err == TIBRV_OK)
+        err = tibrvMsg_SetSendSubject(request, BENCH_SUBJECT);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to build request: %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+
+    rvu_PacerInit(&pacer, (tibrv_f64)rate);
+
+    tibrvMsg_GetCurrentTime(&measureStart);
+
+    for (i = 0; i < count + warmup; i++)
+    {
+        rvu_PacerAcquire(&pacer, 1.0);
+
+        tibrvMsg_GetCurrentTime(&sendTime);
+
+        err = tibrvTransport_SendRequest(transport, request, &reply,
+                                         REQUEST_TIMEOUT);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr,
+                    "%s: Request %u (size=%u rate=%u) failed: %s\n",
+                    progname, i, msgSize, rate, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        tibrvMsg_GetCurrentTime(&recvTime);
+        tibrvMsg_Destroy(reply);
+
+        if (i + 1 == warmup)
+        {
+            /* Warm-up complete: restart the clock and the bucket so
+               the measured interval excludes it. */
+            tibrvMsg_GetCurrentTime(&measureStart);
+            rvu_PacerRestart(&pacer);
+            continue;
+        }
+
+        if (i >= warmup)
+        {
+            rvu_HistRecord(&latency_hist,
+                           (tibrv_f64)(recvTime.sec - sendTime.sec) +
+                           ((tibrv_f64)recvTime.nsec -
+                            (tibrv_f64)sendTime.nsec)*1e-9);
+            measured++;
+        }
+    }
+
+    tibrvMsg_GetCurrentTime(&recvTime);
+    elapsed = (tibrv_f64)(recvTime.sec - measureStart.sec) +
+              ((tibrv_f64)recvTime.nsec - (tibrv_f64)measureStart.nsec)*1e-9;
+    if (elapsed <= 0.0)
+        elapsed = 1e-9;
+
+    printf("%u,%u,%u,%.0f,%.3f,%u,%u,%u,%u,%.0f\n",
+           msgSize, rate, measured,
+           (tibrv_f64)measured/elapsed,
+           ((tibrv_f64)measured*(tibrv_f64)msgSize)/(elapsed*1048576.0),
+           rvu_HistPercentile(&latency_hist, 50.0),
+           rvu_HistPercentile(&latency_hist, 90.0),
+           rvu_HistPercentile(&latency_hist, 99.0),
+           rvu_HistPercentile(&latency_hist, 99.9),
+           latency_hist.max_seconds * 1000000.0);
+    fflush(stdout);
+
+    rvu_PacerDestroy(&pacer);
+    tibrvMsg_Destroy(request);
+    free(payload);
+}
+
+int
+main(int argc, char** argv)
+{
+    tibrv_status        err;
+    tibrvTransport      transport;
+    rvuParams           params;
+
+    int                 reflector = 0;
+    tibrv_u32           sizes[MAX_SWEEP];
+    tibrv_u32           rates[MAX_SWEEP];
+    int                 numSizes = 1;
+    int                 numRates = 1;
+    tibrv_u32           count = DEFAULT_COUNT;
+    tibrv_u32           warmup = DEFAULT_WARMUP;
+    int                 s;
+    int                 r;
+    int                 i = 1;
+
+    progname = argv[0];
+
+    memset(&params, 0, sizeof(params));
+    sizes[0] = 64;
+    rates[0] = 0;
+
+    if (i < argc &&
+        (strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "-h") == 0 ||
+         strcmp(argv[i], "?") == 0))
+        usage();
+
+    while (i < argc && *argv[i] == '-')
+    {
+        if (rvu_ParseTransportArg(argc, argv, &i, &params))
+            continue;
+
+        if (strcmp(argv[i], "-reflect") == 0)
+        {
+            reflector = 1;
+            i += 1;
+        }
+        else if (strcmp(argv[i], "-sizes") == 0 && i+2 <= argc)
+        {
+            numSizes = parse_sweep_list(argv[i+1], sizes, MAX_SWEEP);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-rates") == 0 && i+2 <= argc)
+        {
+            numRates = parse_sweep_list(argv[i+1], rates, MAX_SWEEP);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-count") == 0 && i+2 <= argc)
+        {
+            count = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-warmup") == 0 && i+2 <= argc)
+        {
+            warmup = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            i += 2;
+        }
+        else
+        {
+            usage();
+        }
+    }
+
+    if (count == 0)
+        usage();
+
+    if (!rvu_HistSelfCheck())
+    {
+        fprintf(stderr, "%s: latency histogram self-check failed\n",
+                progname);
+        exit(1);
+    }
+
+    /*
+     * Create internal TIB/Rendezvous machinery
+     */
+    err = tibrv_Open();
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to open TIB/Rendezvous: %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+
+    err = rvu_GetTransport(&params, progname, &transport);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to initialize transport: %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+
+    if (reflector)
+    {
+        run_reflector(transport);
+    }
+    else
+    {
+        printf("size_bytes,rate_msgs_sec,measured,msgs_per_sec,mb_per_sec,"
+               "p50_us,p90_us,p99_us,p99_9_us,max_us\n");
+
+        for (s = 0; s < numSizes; s++)
+            for (r = 0; r < numRates; r++)
+                run_config(transport, sizes[s], rates[r], count, warmup);
+    }
+
+    rvu_DestroyTransports();
+    tibrv_Close();
+
+    return 0;
+}
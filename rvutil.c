@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 1998-2023 Cloud Software Group, Inc.
+ * All Rights Reserved.
+ */
+
+/*
+ * rvutil - shared transport and argument helpers for the example tools
+ *
+ * See rvutil.h for the interface description.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tibrv/tibrv.h"
+
+#include "rvutil.h"
+
+#define MAX_CACHED_TRANSPORTS (16)
+
+/*
+ * One cache slot per distinct (service, network, daemon) triple.  The
+ * parameter strings are copied because callers commonly pass argv
+ * pointers whose lifetime we do not control.
+ */
+typedef struct
+{
+    char*               serviceStr;
+    char*               networkStr;
+    char*               daemonStr;
+    tibrvTransport      transport;
+} transportCacheEntry;
+
+static transportCacheEntry  transportCache[MAX_CACHED_TRANSPORTS];
+static int                  numCached = 0;
+
+tibrv_bool
+rvu_ParseTransportArg(
+    int                 argc,
+    char*               argv[],
+    int*                i,
+    rvuParams*          params)
+{
+    if (*i + 2 > argc || *argv[*i] != '-')
+        return TIBRV_FALSE;
+
+    if (strcmp(argv[*i], "-service") == 0)
+    {
+        params->serviceStr = argv[*i+1];
+        *i += 2;
+        return TIBRV_TRUE;
+    }
+    if (strcmp(argv[*i], "-network") == 0)
+    {
+        params->networkStr = argv[*i+1];
+        *i += 2;
+        return TIBRV_TRUE;
+    }
+    if (strcmp(argv[*i], "-daemon") == 0)
+    {
+        params->daemonStr = argv[*i+1];
+        *i += 2;
+        return TIBRV_TRUE;
+    }
+
+    return TIBRV_FALSE;
+}
+
+int
+rvu_GetInitParms(
+    int                 argc,
+    char*               argv[],
+    int                 min_parms,
+    rvuParams*          params,
+    void                (*usageFn)(void))
+{
+    int i = 1;
+
+    if (argc < min_parms)
+        usageFn();
+
+    if (i < argc &&
+        (strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "-h") == 0 ||
+         strcmp(argv[i], "?") == 0))
+        usageFn();
+
+    while (i+2 <= argc && *argv[i] == '-')
+    {
+        if (!rvu_ParseTransportArg(argc, argv, &i, params))
+            usageFn();
+    }
+
+    return( i );
+}
+
+/*
+ * Compare two parameter strings where NULL means "use the default".
+ */
+static int
+param_equal(
+    const char*         a,
+    const char*         b)
+{
+    if (a == NULL || b == NULL)
+        return (a == b);
+    return (strcmp(a, b) == 0);
+}
+
+static char*
+param_copy(
+    const char*         s)
+{
+    return (s == NULL) ? NULL : strdup(s);
+}
+
+tibrv_status
+rvu_GetTransport(
+    const rvuParams*    params,
+    const char*         description,
+    tibrvTransport*     transport)
+{
+    tibrv_status        err;
+    transportCacheEntry* entry;
+    int                 i;
+
+    /*
+     * Return the cached transport when one already exists for this
+     * triple; several components in one process then share a single
+     * daemon connection.
+     */
+    for (i = 0; i < numCached; i++)
+    {
+        entry = &transportCache[i];
+        if (param_equal(entry->serviceStr, params->serviceStr) &&
+            param_equal(entry->networkStr, params->networkStr) &&
+            param_equal(entry->daemonStr, params->daemonStr))
+        {
+            *transport = entry->transport;
+            return TIBRV_OK;
+        }
+    }
+
+    if (numCached >= MAX_CACHED_TRANSPORTS)
+        return TIBRV_NO_MEMORY;
+
+    entry = &transportCache[numCached];
+
+    err = tibrvTransport_Create(&entry->transport, params->serviceStr,
+                                params->networkStr, params->daemonStr);
+    if (err != TIBRV_OK)
+        return(err);
+
+    if (description != NULL)
+        tibrvTransport_SetDescription(entry->transport, description);
+
+    entry->serviceStr = param_copy(params->serviceStr);
+    entry->networkStr = param_copy(params->networkStr);
+    entry->daemonStr = param_copy(params->daemonStr);
+    numCached++;
+
+    *transport = entry->transport;
+    return TIBRV_OK;
+}
+
+void
+rvu_DestroyTransports(void)
+{
+    int i;
+
+    for (i = 0; i < numCached; i++)
+    {
+        tibrvTransport_Destroy(transportCache[i].transport);
+        free(transportCache[i].serviceStr);
+        free(transportCache[i].networkStr);
+        free(transportCache[i].daemonStr);
+    }
+    numCached = 0;
+}
+
+/* Map a latency in microseconds to its histogram bucket. */
+static tibrv_u32
+hist_bucket(tibrv_u32 us)
+{
+    tibrv_u32 exp = 0;
+    tibrv_u32 v;
+
+    if (us < RVU_HIST_LINEAR)
+        return us;
+
+    for (v = us; v >= (1u << 7); v >>= 1)
+        exp++;
+    if (exp > RVU_HIST_MAX_EXP - 7)
+        exp = RVU_HIST_MAX_EXP - 7;
+
+    /* RVU_HIST_SUBBUCKETS linear sub-buckets across
+       [2^(exp+6), 2^(exp+7)) */
+    return RVU_HIST_LINEAR + exp * RVU_HIST_SUBBUCKETS +
+           ((us >> (exp + 1)) & (RVU_HIST_SUBBUCKETS - 1));
+}
+
+/* Reverse mapping: representative microsecond value of a bucket.  The
+   forward map stores the sub-bucket index (us >> (exp + 1)) & 63,
+   which already carries the leading bit of the value, so the reverse
+   map only shifts it back. */
+static tibrv_u32
+hist_bucket_value(tibrv_u32 bucket)
+{
+    tibrv_u32 exp;
+
+    if (bucket < RVU_HIST_LINEAR)
+        return bucket;
+
+    exp = (bucket - RVU_HIST_LINEAR) / RVU_HIST_SUBBUCKETS;
+    return ((bucket - RVU_HIST_LINEAR) % RVU_HIST_SUBBUCKETS)
+           << (exp + 1);
+}
+
+void
+rvu_HistReset(
+    rvuHist*            hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+void
+rvu_HistRecord(
+    rvuHist*            hist,
+    tibrv_f64           seconds)
+{
+    tibrv_u32 us = (tibrv_u32)(seconds * 1000000.0);
+
+    hist->buckets[hist_bucket(us)]++;
+    hist->count++;
+    if (seconds > hist->max_seconds)
+        hist->max_seconds = seconds;
+}
+
+void
+rvu_HistMerge(
+    rvuHist*            into,
+    const rvuHist*      from)
+{
+    tibrv_u32 i;
+
+    for (i = 0; i < RVU_HIST_BUCKETS; i++)
+        into->buckets[i] += from->buckets[i];
+    into->count += from->count;
+    if (from->max_seconds > into->max_seconds)
+        into->max_seconds = from->max_seconds;
+}
+
+tibrv_u32
+rvu_HistPercentile(
+    const rvuHist*      hist,
+    tibrv_f64           pct)
+{
+    tibrv_u32 target;
+    tibrv_u32 seen = 0;
+    tibrv_u32 i;
+
+    if (hist->count == 0)
+        return 0;
+
+    target = (tibrv_u32)((pct / 100.0) * hist->count + 0.5);
+    if (target > hist->count)
+        target = hist->count;
+
+    for (i = 0; i < RVU_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= target)
+            return hist_bucket_value(i);
+    }
+    return (tibrv_u32)(hist->max_seconds * 1000000.0);
+}
+
+tibrv_bool
+rvu_HistSelfCheck(void)
+{
+    tibrv_u32 us;
+    tibrv_u32 bucket;
+    tibrv_u32 value;
+
+    for (us = 0; us < (1u << RVU_HIST_MAX_EXP); us += us / 3 + 1)
+    {
+        bucket = hist_bucket(us);
+        value = hist_bucket_value(bucket);
+        if (value > us || hist_bucket(value) != bucket)
+        {
+            fprintf(stderr,
+                    "rvutil: latency histogram self-check failed: "
+                    "%u usec -> bucket %u -> %u usec\n",
+                    us, bucket, value);
+            return TIBRV_FALSE;
+        }
+    }
+    return TIBRV_TRUE;
+}
+
+tibrv_status
+rvu_PacerInit(
+    rvuPacer*           pacer,
+    tibrv_f64           rate)
+{
+    pacer->rate = rate;
+    pacer->tokens = 0.0;
+    pacer->lastFill = 0.0;
+    pacer->waitQueue = TIBRV_INVALID_ID;
+    tibrvMsg_GetCurrentTime(&pacer->start);
+
+    /* An empty TIB/RV queue stands in for short sleeps while the
+       bucket refills; unpaced runs never wait, so skip it. */
+    if (rate > 0.0)
+        return tibrvQueue_Create(&pacer->waitQueue);
+
+    return TIBRV_OK;
+}
+
+void
+rvu_PacerRestart(
+    rvuPacer*           pacer)
+{
+    pacer->tokens = 0.0;
+    pacer->lastFill = 0.0;
+    tibrvMsg_GetCurrentTime(&pacer->start);
+}
+
+void
+rvu_PacerAcquire(
+    rvuPacer*           pacer,
+    tibrv_f64           need)
+{
+    tibrvMsgDateTime    now;
+    tibrv_f64           elapsed;
+
+    if (pacer->rate <= 0.0)
+        return;
+
+    /* Refill the bucket from elapsed time, capping bursts at roughly
+       1/10 second worth of messages, and stall on the wait queue
+       while not enough tokens are available. */
+    while (pacer->tokens < need)
+    {
+        tibrvMsg_GetCurrentTime(&now);
+        elapsed = (tibrv_f64)(now.sec - pacer->start.sec) +
+                  ((tibrv_f64)now.nsec - (tibrv_f64)pacer->start.nsec)*1e-9;
+        pacer->tokens += (elapsed - pacer->lastFill) * pacer->rate;
+        pacer->lastFill = elapsed;
+        if (pacer->tokens > pacer->rate/10.0 + need)
+            pacer->tokens = pacer->rate/10.0 + need;
+        if (pacer->tokens < need)
+            tibrvQueue_TimedDispatch(pacer->waitQueue, (tibrv_f64)0.001);
+    }
+    pacer->tokens -= need;
+}
+
+void
+rvu_PacerDestroy(
+    rvuPacer*           pacer)
+{
+    if (pacer->waitQueue != TIBRV_INVALID_ID)
+    {
+        tibrvQueue_Destroy(pacer->waitQueue);
+        pacer->waitQueue = TIBRV_INVALID_ID;
+    }
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 1998-2023 Cloud Software Group, Inc.
+ * All Rights Reserved.
+ */
+
+/*
+ * rvutil - shared transport and argument helpers for the example tools
+ *
+ * Every example in this directory parses the same -service/-network/
+ * -daemon parameters and creates its own tibrvTransport.  These helpers
+ * centralize that work:
+ *
+ *   rvu_ParseTransportArg  consumes one transport parameter pair from
+ *                          an argv scan loop, so tools with their own
+ *                          flags can delegate just the common ones.
+ *
+ *   rvu_GetInitParms       parses all leading transport parameters for
+ *                          tools with no additional flags and returns
+ *                          the index of the first remaining argument.
+ *
+ *   rvu_GetTransport       transport factory.  Transports are cached
+ *                          by their (service, network, daemon) triple,
+ *                          so a combined tool that asks for the same
+ *                          parameters from several components shares
+ *                          one daemon connection instead of opening
+ *                          one per component.
+ *
+ *   rvu_DestroyTransports  destroys all cached transports; call before
+ *                          tibrv_Close().
+ *
+ *   rvu_Hist*              log-linear latency histogram shared by the
+ *                          benchmarking tools, with percentile lookup
+ *                          and a startup self-check of the bucket
+ *                          mappings.
+ *
+ *   rvu_Pacer*             token-bucket send pacer shared by the tools
+ *                          that publish at a requested msgs/sec rate.
+ */
+
+#ifndef RVUTIL_H
+#define RVUTIL_H
+
+#include "tibrv/tibrv.h"
+
+/* Transport creation parameters shared by all the example tools. */
+typedef struct
+{
+    char*               serviceStr;
+    char*               networkStr;
+    char*               daemonStr;
+} rvuParams;
+
+/*
+ * If argv[*i] is one of -service, -network or -daemon with a value,
+ * store the value in params, advance *i past the pair and return
+ * TIBRV_TRUE.  Otherwise leave *i alone and return TIBRV_FALSE.
+ */
+extern tibrv_bool
+rvu_ParseTransportArg(
+    int                 argc,
+    char*               argv[],
+    int*                i,
+    rvuParams*          params);
+
+/*
+ * Parse all leading transport parameter pairs from the command line.
+ * Returns the index of the first argument that is not a transport
+ * parameter.  Unrecognized -flags are an error reported through the
+ * caller's usage routine.
+ */
+extern int
+rvu_GetInitParms(
+    int                 argc,
+    char*               argv[],
+    int                 min_parms,
+    rvuParams*          params,
+    void                (*usageFn)(void));
+
+/*
+ * Return a transport for the given parameters, creating it on first
+ * use and returning the cached handle on every later call with the
+ * same (service, network, daemon) triple.
+ */
+extern tibrv_status
+rvu_GetTransport(
+    const rvuParams*    params,
+    const char*         description,
+    tibrvTransport*     transport);
+
+/* Destroy every transport created by rvu_GetTransport. */
+extern void
+rvu_DestroyTransports(void);
+
+/*
+ * HDR-style log-linear latency histogram: one microsecond resolution
+ * below RVU_HIST_LINEAR microseconds, then RVU_HIST_SUBBUCKETS linear
+ * sub-buckets per power of two above that.
+ */
+#define RVU_HIST_LINEAR     64
+#define RVU_HIST_SUBBUCKETS 64
+#define RVU_HIST_MAX_EXP    24              /* covers up to ~16.7 sec  */
+#define RVU_HIST_BUCKETS    (RVU_HIST_LINEAR + \
+                            (RVU_HIST_MAX_EXP - 6) * RVU_HIST_SUBBUCKETS)
+
+/* A zero-initialized rvuHist is empty; tools that keep one histogram
+   per thread merge them with rvu_HistMerge once the threads are
+   quiescent. */
+typedef struct
+{
+    tibrv_u32           buckets[RVU_HIST_BUCKETS];
+    tibrv_u32           count;
+    tibrv_f64           max_seconds;
+} rvuHist;
+
+/* Empty the histogram, e.g. between sweep configurations. */
+extern void
+rvu_HistReset(
+    rvuHist*            hist);
+
+/* Record one latency sample (in seconds). */
+extern void
+rvu_HistRecord(
+    rvuHist*            hist,
+    tibrv_f64           seconds);
+
+/* Add every sample of from into into. */
+extern void
+rvu_HistMerge(
+    rvuHist*            into,
+    const rvuHist*      from);
+
+/*
+ * Return the approximate latency in microseconds at the given
+ * percentile (0.0 - 100.0).
+ */
+extern tibrv_u32
+rvu_HistPercentile(
+    const rvuHist*      hist,
+    tibrv_f64           pct);
+
+/*
+ * Sanity-check the bucket mappings: for a sweep of latencies the
+ * representative bucket value must land back in the same bucket and
+ * never exceed the latency it stands for.  Returns TIBRV_FALSE (after
+ * reporting the offending value on stderr) if the mappings disagree;
+ * call once at startup and fail fast, since a broken mapping silently
+ * corrupts every reported percentile.
+ */
+extern tibrv_bool
+rvu_HistSelfCheck(void);
+
+/*
+ * Token-bucket send pacer.  The bucket refills from elapsed time at
+ * the configured rate, bursts are capped at roughly 1/10 second worth
+ * of messages, and an empty TIB/RV queue stands in for short sleeps
+ * while the bucket refills.
+ */
+typedef struct
+{
+    tibrv_f64           rate;       /* msgs/sec; 0 disables pacing    */
+    tibrv_f64           tokens;
+    tibrv_f64           lastFill;
+    tibrvMsgDateTime    start;
+    tibrvQueue          waitQueue;
+} rvuPacer;
+
+/*
+ * Set the pacer up for rate messages per second; a rate of 0 turns
+ * every later call into a no-op, so unpaced runs need no special
+ * casing at the call sites.
+ */
+extern tibrv_status
+rvu_PacerInit(
+    rvuPacer*           pacer,
+    tibrv_f64           rate);
+
+/* Restart the clock and empty the bucket, e.g. after a warm-up. */
+extern void
+rvu_PacerRestart(
+    rvuPacer*           pacer);
+
+/*
+ * Block until need tokens are available, then consume them.  Call
+ * with the number of messages about to be sent (1 for single sends,
+ * the batch size for vectored sends).
+ */
+extern void
+rvu_PacerAcquire(
+    rvuPacer*           pacer,
+    tibrv_f64           need);
+
+/* Destroy the pacer's wait queue. */
+extern void
+rvu_PacerDestroy(
+    rvuPacer*           pacer);
+
+#endif /* RVUTIL_H */
@@ -64,6 +64,8 @@
 
 #include "tibrv/tibrv.h"
 
+#include "rvutil.h"
+
 #define DEFAULT_SERVICE     "7522:7524"     /* Two-part service parameter
                                                for direct communication.  To
                                                use ephemeral ports, specify
@@ -131,6 +133,78 @@ static tibrvMsgDateTime    date_time_start, date_time_stop;
 static tibrv_f64           time_start, time_stop, elapsed;
 static const char*         tibrv_version;
 
+/* Round-trip latency histogram.  Replies from the server arrive on a
+   single point-to-point path, so they are received in the order the
+   requests were sent; we record the send time of every request and
+   match replies by arrival index.  Latencies are kept in the shared
+   rvutil log-linear histogram. */
+static tibrv_f64*          send_times = NULL;       /* per-request send time */
+static rvuHist             latency_hist;
+static char*               csv_file = NULL;         /* -csv output path */
+static FILE*               csv_fp = NULL;
+
+/* Sharded mode (-shards N): N transports, each with its own inbox,
+   request stream, response queue and dispatcher thread, so one process
+   can drive daemon-limit load.  Requests are distributed round-robin.
+   Each shard's counters and histogram are touched only by its own
+   dispatcher thread; the histograms are merged into the global one
+   after the run, so no locking is needed.  Note that with direct
+   communication only one transport per host can bind a fixed direct
+   port, so sharded runs should use an ephemeral service ("7522:"). */
+#define MAX_SHARDS          32
+
+typedef struct clientShard
+{
+    tibrvTransport          transport;
+    tibrvQueue              queue;
+    tibrvEvent              listener;
+    tibrvDispatcher         dispatcher;
+    tibrvMsg                request;
+    char                    inbox[TIBRV_SUBJECT_MAX];
+    tibrv_u32               to_send;
+    tibrv_u32               sent;
+    tibrv_u32               responses;
+    tibrv_f64*              send_times;
+    rvuHist                 hist;
+} clientShard;
+
+static clientShard         shards[MAX_SHARDS];
+static tibrv_u32           num_shards = 0;
+
+/* Print a percentile snapshot, and append it to the CSV file when one
+   was requested. */
+static void
+latency_report(const char* label)
+{
+    if (latency_hist.count == 0)
+        return;
+
+    fprintf(stdout,
+            "%s: latency (usec) p50=%u p90=%u p99=%u p99.9=%u max=%.0f "
+            "over %u replies\n",
+            label,
+            rvu_HistPercentile(&latency_hist, 50.0),
+            rvu_HistPercentile(&latency_hist, 90.0),
+            rvu_HistPercentile(&latency_hist, 99.0),
+            rvu_HistPercentile(&latency_hist, 99.9),
+            latency_hist.max_seconds * 1000000.0,
+            latency_hist.count);
+    fflush(stdout);
+
+    if (csv_fp != NULL)
+    {
+        fprintf(csv_fp, "%s,%u,%u,%u,%u,%u,%.0f\n",
+                label,
+                latency_hist.count,
+                rvu_HistPercentile(&latency_hist, 50.0),
+                rvu_HistPercentile(&latency_hist, 90.0),
+                rvu_HistPercentile(&latency_hist, 99.0),
+                rvu_HistPercentile(&latency_hist, 99.9),
+                latency_hist.max_seconds * 1000000.0);
+        fflush(csv_fp);
+    }
+}
+
 /* This routine displays parameter information if invalid parameters are
    detected or the program is executed with a help request flag of
    -help or -h or -? */
@@ -141,7 +215,9 @@ usage(void)
     fprintf(stderr, "                    [-network  <network>]\n");
     fprintf(stderr, "                    [-daemon  <daemon>]\n");
     fprintf(stderr, "                    [-interval <publish interval in seconds>]\n");
-    fprintf(stderr, "                    [-status <#msgs>]    <number of requests>\n");
+    fprintf(stderr, "                    [-status <#msgs>]\n");
+    fprintf(stderr, "                    [-shards <count>]\n");
+    fprintf(stderr, "                    [-csv <file>]        <number of requests>\n");
     exit(1);
 }
 
@@ -219,6 +295,18 @@ getParameters(int           argc,
             *status_frq = (tibrv_u32) atol(argv[i+1]);
             i += 2;
         }
+        else if (strcmp(argv[i], "-csv") == 0)
+        {
+            csv_file = argv[i+1];
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-shards") == 0)
+        {
+            num_shards = (tibrv_u32) atol(argv[i+1]);
+            if (num_shards > MAX_SHARDS)
+                num_shards = MAX_SHARDS;
+            i += 2;
+        }
         else
         {
             usage();
@@ -228,9 +316,9 @@ getParameters(int           argc,
 }
 
 
-/* Put data into the request message. */
+/* Put data into a request message. */
 tibrv_status
-set_msg_data(void)
+set_request_data(tibrvMsg request)
 {
     tibrv_u32           x;
     tibrv_u32           y;
@@ -238,7 +326,7 @@ set_msg_data(void)
 
     /* Put some data into the message to the server. */
     x = ((tibrv_u32) rand());
-    return_code = tibrvMsg_UpdateU32(client_request, "x", x);
+    return_code = tibrvMsg_UpdateU32(request, "x", x);
     if (return_code != TIBRV_OK)
     {
         fprintf(stderr,
@@ -250,7 +338,7 @@ set_msg_data(void)
     else
     {
         y = ((tibrv_u32) rand());
-        return_code = tibrvMsg_UpdateU32(client_request, "y", y);
+        return_code = tibrvMsg_UpdateU32(request, "y", y);
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
@@ -264,6 +352,13 @@ set_msg_data(void)
     return return_code;
 }
 
+/* Put data into the request message. */
+tibrv_status
+set_msg_data(void)
+{
+    return set_request_data(client_request);
+}
+
 
 /* This routine processes responses from our server when we send it messages
    after we have identified it and received its inbox address.  All we do
@@ -276,6 +371,19 @@ serverResponse(
     tibrvMsg    msg,
     void*       arg)
 {
+    tibrvMsgDateTime    now;
+
+    /* Replies arrive in send order, so the arrival index selects the
+       matching send timestamp. */
+    if (send_times != NULL && responses < requests &&
+        send_times[responses] > 0.0)
+    {
+        tibrvMsg_GetCurrentTime(&now);
+        rvu_HistRecord(&latency_hist,
+                       (now.sec + (now.nsec / 1000000000.0)) -
+                       send_times[responses]);
+    }
+
     responses++;
     if (status_frq > 0)
     {
@@ -284,6 +392,7 @@ serverResponse(
             tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
             fprintf(stdout,"%s: %d server responses received\n",
                     gmtTime, responses);
+            latency_report(gmtTime);
         }
     }
 
@@ -330,6 +439,171 @@ timeOut(tibrvEvent      event,
     return;
 }
 
+/* Record one round-trip latency into a shard's private histogram.
+   Only the shard's dispatcher thread touches it. */
+static void
+shard_latency_record(clientShard* shard, tibrv_f64 seconds)
+{
+    rvu_HistRecord(&shard->hist, seconds);
+}
+
+/* Response callback for one shard.  Runs on that shard's dispatcher
+   thread; replies on a shard's point-to-point path arrive in send
+   order, so the arrival index selects the matching send timestamp. */
+static void
+shardResponse(
+    tibrvEvent  event,
+    tibrvMsg    msg,
+    void*       arg)
+{
+    clientShard*        shard = (clientShard*) arg;
+    tibrvMsgDateTime    now;
+
+    if (shard->responses < shard->to_send &&
+        shard->send_times[shard->responses] > 0.0)
+    {
+        tibrvMsg_GetCurrentTime(&now);
+        shard_latency_record(shard,
+                             (now.sec + (now.nsec / 1000000000.0)) -
+                             shard->send_times[shard->responses]);
+    }
+
+    shard->responses++;
+    if (shard->responses >= shard->to_send)
+        tibrvEvent_Destroy(event);    /* this shard is complete */
+    return;
+}
+
+/* Create the per-shard transports, inboxes, queues, listeners,
+   dispatcher threads and request messages. */
+tibrv_status
+setup_shards(void)
+{
+    tibrv_status    return_code = TIBRV_OK;
+    tibrv_u32       s;
+    char            shard_name[32];
+
+    for (s = 0; s < num_shards && return_code == TIBRV_OK; s++)
+    {
+        clientShard* shard = &shards[s];
+
+        shard->to_send = requests / num_shards +
+                         ((s < requests % num_shards) ? 1 : 0);
+        shard->send_times = (tibrv_f64*)calloc(shard->to_send + 1,
+                                               sizeof(tibrv_f64));
+        if (shard->send_times == NULL)
+        {
+            fprintf(stderr, "%s failed to allocate timestamp table\n",
+                    program_name);
+            return TIBRV_NO_MEMORY;
+        }
+
+        return_code = tibrvTransport_Create(&shard->transport, service,
+                                            network, gdaemon);
+        if (return_code == TIBRV_OK)
+        {
+            sprintf(shard_name, "%s-shard-%d", "tibrvclient", s);
+            tibrvTransport_SetDescription(shard->transport, shard_name);
+            return_code = tibrvTransport_CreateInbox(shard->transport,
+                                                     shard->inbox,
+                                                     TIBRV_SUBJECT_MAX);
+        }
+        if (return_code == TIBRV_OK)
+            return_code = tibrvQueue_Create(&shard->queue);
+        if (return_code == TIBRV_OK)
+            return_code = tibrvEvent_CreateListener(&shard->listener,
+                                                    shard->queue,
+                                                    shardResponse,
+                                                    shard->transport,
+                                                    shard->inbox,
+                                                    shard);
+        if (return_code == TIBRV_OK)
+        {
+            return_code = tibrvDispatcher_CreateEx(&shard->dispatcher,
+                                                   shard->queue,
+                                                   REQUEST_TIMEOUT);
+            if (return_code == TIBRV_OK)
+                tibrvDispatcher_SetName(shard->dispatcher, shard_name);
+        }
+        if (return_code == TIBRV_OK)
+            return_code = tibrvMsg_Create(&shard->request);
+        if (return_code == TIBRV_OK)
+            return_code = tibrvMsg_SetSendSubject(shard->request,
+                                                  request_subject);
+        if (return_code == TIBRV_OK)
+            return_code = tibrvMsg_SetReplySubject(shard->request,
+                                                   shard->inbox);
+
+        if (return_code != TIBRV_OK)
+            fprintf(stderr, "%s failed to set up shard %d: %s\n",
+                    program_name, s, tibrvStatus_GetText(return_code));
+    }
+    return return_code;
+}
+
+/* Send all requests, round-robin across the shards. */
+tibrv_status
+send_shards(void)
+{
+    tibrv_status    return_code = TIBRV_OK;
+    tibrv_u32       i;
+
+    for (i = 0; i < requests; i++)
+    {
+        clientShard*        shard = &shards[i % num_shards];
+        tibrvMsgDateTime    send_now;
+
+        return_code = set_request_data(shard->request);
+        if (return_code == TIBRV_OK)
+        {
+            tibrvMsg_GetCurrentTime(&send_now);
+            shard->send_times[shard->sent] = send_now.sec +
+                                             (send_now.nsec / 1000000000.0);
+            return_code = tibrvTransport_Send(shard->transport,
+                                              shard->request);
+        }
+        if (return_code != TIBRV_OK)
+        {
+            fprintf(stderr,
+                    "%s failed to send a client request: %s\n",
+                    program_name,
+                    tibrvStatus_GetText(return_code));
+            break;
+        }
+        shard->sent++;
+        sent++;
+        if (status_frq > 0) {
+            if (((sent)/status_frq)*status_frq == sent) {
+                    tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
+                    fprintf(stdout, "%s: %d client requests sent\n",
+                            gmtTime, sent);
+            }
+        }
+    }
+    return return_code;
+}
+
+/* Merge the per-shard histograms and counters into the global ones so
+   the standard report routines apply.  Called after the dispatcher
+   threads are quiescent. */
+void
+merge_shards(void)
+{
+    tibrv_u32   s;
+
+    for (s = 0; s < num_shards; s++)
+    {
+        clientShard* shard = &shards[s];
+
+        rvu_HistMerge(&latency_hist, &shard->hist);
+        responses += shard->responses;
+
+        fprintf(stdout, "  shard %d: sent %d, responses %d, max %.0f usec\n",
+                s, shard->sent, shard->responses,
+                shard->hist.max_seconds * 1000000.0);
+    }
+}
+
 /*
  * Timer callback called according to specified interval.  Publishes a request
  * message each time the callback executes.
@@ -352,7 +626,14 @@ pubMsg(tibrvEvent      event,
         if (return_code == TIBRV_OK)
             return_code = tibrvMsg_SetReplySubject(copyToSend, inbox_subject);
         if (return_code == TIBRV_OK)
+        {
+            tibrvMsgDateTime send_now;
+            tibrvMsg_GetCurrentTime(&send_now);
+            if (send_times != NULL)
+                send_times[sent] = send_now.sec +
+                                   (send_now.nsec / 1000000000.0);
             return_code = tibrvTransport_Send(transport, copyToSend);
+        }
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
@@ -543,7 +824,13 @@ send_msgs_cont(void)
 
     for (i = 0; i < requests; i++)
     {
+        tibrvMsgDateTime send_now;
+
         set_msg_data();
+        tibrvMsg_GetCurrentTime(&send_now);
+        if (send_times != NULL)
+            send_times[sent] = send_now.sec +
+                               (send_now.nsec / 1000000000.0);
         /* Send a request message to the server. */
         return_code = tibrvTransport_Send(transport, client_request);
         if (return_code != TIBRV_OK)
@@ -587,6 +874,8 @@ report_results(void)
                     responses, requests);
     }
 
+    latency_report("final");
+
 }
 
 /* This is the main routine. */
@@ -601,6 +890,36 @@ main(int argc, char** argv)
     {
         requests = atoi(argv[last_argument_index]);
     }
+
+    if (!rvu_HistSelfCheck())
+    {
+        fprintf(stderr, "%s: latency histogram self-check failed\n",
+                program_name);
+        exit(1);
+    }
+
+    /* Per-request send timestamps for the latency histogram. */
+    send_times = (tibrv_f64*)calloc(requests, sizeof(tibrv_f64));
+    if (send_times == NULL)
+    {
+        fprintf(stderr, "%s failed to allocate timestamp table\n",
+                program_name);
+        exit(1);
+    }
+
+    if (csv_file != NULL)
+    {
+        csv_fp = fopen(csv_file, "w");
+        if (csv_fp == NULL)
+        {
+            fprintf(stderr, "%s failed to open CSV file %s\n",
+                    program_name, csv_file);
+            exit(1);
+        }
+        fprintf(csv_fp,
+                "label,replies,p50_us,p90_us,p99_us,p99_9_us,max_us\n");
+    }
+
     return_code = open_RVMechanisms();
     if (return_code == TIBRV_OK)
     {
@@ -621,7 +940,7 @@ main(int argc, char** argv)
     }
     if (return_code == TIBRV_OK)
     {
-        return_code = finish_setup();
+        return_code = (num_shards > 0) ? setup_shards() : finish_setup();
     }
     if (return_code == TIBRV_OK)
     {
@@ -631,21 +950,29 @@ main(int argc, char** argv)
         tibrvMsg_GetCurrentTime(&date_time_start);
         time_start = date_time_start.sec + (date_time_start.nsec / 1000000000.0);
         last_response_count = responses;
-        return_code = tibrvEvent_CreateTimer(
-                                 &timeout_id,
-                                 response_queue,
-                                 timeOut,
-                                 (WAIT_EXIT + interval),
-                                 "");
-        if (return_code != TIBRV_OK)
+        if (num_shards == 0)
         {
-            fprintf(stderr,"Error adding the timeout event: --%s\n",
-                    tibrvStatus_GetText(return_code));
+            return_code = tibrvEvent_CreateTimer(
+                                     &timeout_id,
+                                     response_queue,
+                                     timeOut,
+                                     (WAIT_EXIT + interval),
+                                     "");
+            if (return_code != TIBRV_OK)
+            {
+                fprintf(stderr,"Error adding the timeout event: --%s\n",
+                        tibrvStatus_GetText(return_code));
+            }
         }
     }
     if (return_code == TIBRV_OK)
     {
-        if (interval == 0.0)
+        if (num_shards > 0)
+        {
+            /* Sharded runs send continuously; -interval does not apply. */
+            return_code = send_shards();
+        }
+        else if (interval == 0.0)
         {
             return_code = send_msgs_cont();
         }
@@ -659,17 +986,60 @@ main(int argc, char** argv)
         }
     }
 
-    while(!done && (return_code == TIBRV_OK))
+    if (num_shards > 0)
+    {
+        /* Wait until the shard dispatcher threads have collected all
+           responses, or no progress is made for WAIT_EXIT seconds. */
+        tibrv_u32   total = 0;
+        tibrv_u32   last_total = 0;
+        tibrv_f64   waited = 0.0;
+        tibrv_u32   s;
+
+        while (return_code == TIBRV_OK)
+        {
+            total = 0;
+            for (s = 0; s < num_shards; s++)
+                total += shards[s].responses;
+            if (total >= requests)
+                break;
+
+            tibrvQueue_TimedDispatch(TIBRV_DEFAULT_QUEUE, DISP_TIMEOOUT);
+            waited += DISP_TIMEOOUT;
+            if (waited >= WAIT_EXIT)
+            {
+                if (total == last_total)
+                {
+                    return_code = TIBRV_TIMEOUT;
+                    break;
+                }
+                last_total = total;
+                waited = 0.0;
+            }
+        }
+        tibrvMsg_GetCurrentTime(&date_time_stop);
+        time_stop = date_time_stop.sec + (date_time_stop.nsec / 1000000000.0);
+        elapsed = time_stop - time_start;
+
+        fprintf(stdout, "%d shards:\n", num_shards);
+        merge_shards();
+        if (elapsed > 0.0)
+            fprintf(stdout, "aggregate rate %.0f requests/sec over %d shards\n",
+                    requests / elapsed, num_shards);
+    }
+    else
     {
-        if (responses < requests)
+        while(!done && (return_code == TIBRV_OK))
         {
-            tibrvQueue_TimedDispatch(TIBRV_DEFAULT_QUEUE,
-                                                    DISP_TIMEOOUT);
-            if (tibrv_err != TIBRV_OK)
-                return_code = tibrv_err;
+            if (responses < requests)
+            {
+                tibrvQueue_TimedDispatch(TIBRV_DEFAULT_QUEUE,
+                                                        DISP_TIMEOOUT);
+                if (tibrv_err != TIBRV_OK)
+                    return_code = tibrv_err;
+            }
+            else
+                break;
         }
-        else
-            break;
     }
 
     if (return_code != TIBRV_OK)
@@ -692,8 +1062,27 @@ main(int argc, char** argv)
         tibrvQueue_Destroy(timeout_id);
     if (response_thread != TIBRV_INVALID_ID)
         tibrvDispatcher_Destroy(response_thread);
+    if (num_shards > 0)
+    {
+        tibrv_u32 s;
+        for (s = 0; s < num_shards; s++)
+        {
+            if (shards[s].request != TIBRV_INVALID_ID)
+                tibrvMsg_Destroy(shards[s].request);
+            if (shards[s].dispatcher != TIBRV_INVALID_ID)
+                tibrvDispatcher_Destroy(shards[s].dispatcher);
+            if (shards[s].queue != TIBRV_INVALID_ID)
+                tibrvQueue_Destroy(shards[s].queue);
+            if (shards[s].transport != TIBRV_INVALID_ID)
+                tibrvTransport_Destroy(shards[s].transport);
+            free(shards[s].send_times);
+        }
+    }
     if (transport != TIBRV_INVALID_ID)
         tibrvTransport_Destroy(transport);
+    if (csv_fp != NULL)
+        fclose(csv_fp);
+    free(send_times);
     /* Close the Tibrv machinery and exit. */
     tibrv_Close();
     return return_code;
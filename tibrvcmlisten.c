@@ -39,13 +39,20 @@
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+
+#ifdef _WIN32
 #include <windows.h>
 
 #include <c:\tibco\tibrv\8.7\include\tibrv\tibrv.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\cm.h>
+#else
+#include <unistd.h>
+
+#include "tibrv/tibrv.h"
+#include "tibrv/cm.h"
 
-//#include "tibrv/tibrv.h"
-//#include "tibrv/cm.h"
+#define Sleep(ms) usleep((ms)*1000)
+#endif
 
 #define MIN_PARMS (2)
 
@@ -61,6 +68,65 @@ int g_alloc_count = 0;
 #define PRE_ALLOC_SIZE (50ULL * 1024 * 1024 * 1024) // 15GB (64bit 환경 테스트용)
 void *g_nomem_buffer = NULL;
 #endif
+
+/*
+ * Batched explicit confirmation (-confirm-batch N).  The listeners are
+ * switched to explicit confirmation and received messages are detached
+ * and parked instead of being confirmed one at a time.  Once N are
+ * outstanding (or the flush timer fires) the whole batch is confirmed
+ * back to back, so ledger writes coalesce instead of forcing a disk
+ * sync per delivery.
+ */
+#define MAX_PENDING (1024)
+
+typedef struct
+{
+    tibrvcmEvent        event;
+    tibrvMsg            message;
+} pendingConfirm;
+
+static tibrv_u32        confirmBatch = 0;   /* 0 = automatic confirms  */
+static pendingConfirm   pending[MAX_PENDING];
+static tibrv_u32        numPending = 0;
+static tibrv_u32        confirmedBatches = 0;
+static tibrv_u64        confirmedMsgs = 0;
+
+static void
+flush_confirmations(void)
+{
+    tibrv_status        err;
+    tibrv_u32           i;
+
+    if (numPending == 0)
+        return;
+
+    for (i = 0; i < numPending; i++)
+    {
+        err = tibrvcmEvent_ConfirmMsg(pending[i].event, pending[i].message);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to confirm message --%s\n",
+                    progname, tibrvStatus_GetText(err));
+        }
+        tibrvMsg_Destroy(pending[i].message);
+    }
+
+    confirmedMsgs += numPending;
+    confirmedBatches++;
+    numPending = 0;
+}
+
+/*
+ * Flush timer so a quiet subject does not leave a partial batch
+ * unconfirmed (and the sender's ledger growing) indefinitely.
+ */
+static void
+confirmTimerCB(tibrvEvent      event,
+               tibrvMsg        message,
+               void *          closure)
+{
+    flush_confirmations();
+}
 /*
  * RVFT advisory callback may detect and address problems.
  * This simple routine only prints messages.
@@ -83,6 +149,19 @@ advCB(tibrvEvent        event,
         fprintf(stderr,
                 "#### RVFT ADVISORY: %s \nAdvisory message is: %s\n",
                 name, string);
+
+        /* In batched-confirmation mode report how full the unconfirmed
+           window is; a saturated window during an advisory usually
+           means confirmations are not keeping up with delivery. */
+        if (confirmBatch > 0)
+        {
+            fprintf(stderr,
+                    "#### unconfirmed window: %u of %u%s "
+                    "(%llu msgs confirmed in %u batches)\n",
+                    numPending, MAX_PENDING,
+                    (numPending >= MAX_PENDING) ? " -- SATURATED" : "",
+                    (unsigned long long)confirmedMsgs, confirmedBatches);
+        }
     }
 
     return;
@@ -255,6 +334,29 @@ Sleep(1000);
         }
     }
 
+    /*
+     * Batched explicit confirmation: detach the message so it survives
+     * this callback and park it until the batch is full.
+     */
+    if (confirmBatch > 0 && listener_registered)
+    {
+        err = tibrvMsg_Detach(message);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to detach message --%s\n",
+                    progname, tibrvStatus_GetText(err));
+        }
+        else
+        {
+            pending[numPending].event   = event;
+            pending[numPending].message = message;
+            numPending++;
+
+            if (numPending >= confirmBatch || numPending >= MAX_PENDING)
+                flush_confirmations();
+        }
+    }
+
     fflush(stdout);
 }
 
@@ -263,7 +365,8 @@ usage(void)
 {
     fprintf(stderr,"tibrvcmlisten [-service service] [-network network] \n");
     fprintf(stderr,"              [-daemon daemon] [-ledger <filename>]\n");
-    fprintf(stderr,"              [-cmname cmname] subject_list\n");
+    fprintf(stderr,"              [-cmname cmname] [-confirm-batch N]\n");
+    fprintf(stderr,"              subject_list\n");
     exit(1);
 }
 
@@ -318,6 +421,13 @@ get_InitParms(
             *cmnameStr = argv[i+1];
             i+=2;
         }
+        else if(strcmp(argv[i], "-confirm-batch") == 0)
+        {
+            confirmBatch = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            if (confirmBatch > MAX_PENDING)
+                confirmBatch = MAX_PENDING;
+            i+=2;
+        }
         else
         {
             usage();
@@ -412,8 +522,38 @@ main(int argc, char** argv)
             exit(2);
         }
 
+        /* Batched confirmation requires explicit confirms. */
+        if (confirmBatch > 0)
+        {
+            err = tibrvcmEvent_SetExplicitConfirm(cmlistenId);
+            if (err != TIBRV_OK)
+            {
+                fprintf(stderr,
+                        "%s: Error %s enabling explicit confirm on \"%s\"\n",
+                        progname, tibrvStatus_GetText(err), argv[currentArg]);
+                exit(2);
+            }
+        }
+
         currentArg++;
     }
+
+    /* Flush timer for partial confirmation batches. */
+    if (confirmBatch > 0)
+    {
+        tibrvEvent confirmTimerId;
+
+        printf("tibrvcmlisten: Confirming every %u messages\n", confirmBatch);
+
+        err = tibrvEvent_CreateTimer(&confirmTimerId, TIBRV_DEFAULT_QUEUE,
+                                     confirmTimerCB, (tibrv_f64)1.0, NULL);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to create confirm timer --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(2);
+        }
+    }
     #if 0
 //"_RV.CM.DELIVERY.CONFIRM.RVCMPUB.RVCMSUB>"
     /* DELIVERY.CONFIRM 메시지 listener 추가 */
@@ -47,9 +47,15 @@
 #include <string.h>
 #include <time.h>
 
+#ifdef _WIN32
 #include <c:\tibco\tibrv\8.7\include\tibrv\tibrv.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\cm.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\ft.h>
+#else
+#include "tibrv/tibrv.h"
+#include "tibrv/cm.h"
+#include "tibrv/ft.h"
+#endif
 
 /* 상단 includes */
 #include <time.h>
@@ -57,37 +63,221 @@
   #include <windows.h>  /* for Sleep(ms) */
 #else
   #include <unistd.h>   /* for usleep */
+  #include <pthread.h>
 #endif
-//#include "tibrv/tibrv.h"
-//#include "tibrv/cm.h"
+
+#include "advmon.h"
 
 #define MIN_PARMS (2)
 
 char*   progname;
 
+/*
+ * Multi-worker mode (-workers N).  The DQ member's listeners are moved
+ * off the default queue onto a dedicated queue drained by N dispatcher
+ * threads.  Each worker thread is identified by its thread id the
+ * first time it runs a callback and gets its own processed counter;
+ * processing time is recorded in a power-of-two histogram so the
+ * periodic report can show percentiles across workers.
+ */
+#define MAX_WORKERS         (32)
+#define PROC_HIST_BUCKETS   (40)    /* log2(usec) buckets */
+#define STATS_INTERVAL      (5.0)   /* seconds between worker reports */
+
+typedef struct
+{
+#ifdef _WIN32
+    DWORD               threadId;
+#else
+    pthread_t           threadId;
+#endif
+    tibrv_bool          used;
+    tibrv_u32           processed;
+} workerStats;
+
+static tibrv_u32        numWorkers = 0;
+static workerStats      workerTable[MAX_WORKERS];
+static tibrvQueue       workerQueue = TIBRV_INVALID_ID;
+static tibrvDispatcher  workerDispatchers[MAX_WORKERS];
+static tibrv_u32        procHist[PROC_HIST_BUCKETS];
+static tibrv_u32        procCount = 0;
+static tibrv_f64        procMax = 0.0;
+
+/* The worker dispatcher threads claim slots and record their stats
+   concurrently while the report timer reads them from the default
+   queue, so workerTable and the procHist counters are guarded by
+   statsLock, as in dispatcher.c and priority.c. */
+#ifdef _WIN32
+static CRITICAL_SECTION statsLock;
+#define STATS_LOCK()    EnterCriticalSection(&statsLock)
+#define STATS_UNLOCK()  LeaveCriticalSection(&statsLock)
+#else
+static pthread_mutex_t  statsLock = PTHREAD_MUTEX_INITIALIZER;
+#define STATS_LOCK()    pthread_mutex_lock(&statsLock)
+#define STATS_UNLOCK()  pthread_mutex_unlock(&statsLock)
+#endif
+
+/* Optional queue bound (-qlimit max,discard[,first|last|new]).  The
+   limit policy goes on whichever queue receives the CM listeners, so
+   a subject burst discards under the chosen policy instead of growing
+   the queue without bound.  The QUEUE.LIMIT_EXCEEDED advisory counts
+   the discards for the periodic report. */
+static tibrv_u32        qlimitMax = 0;
+static tibrv_u32        qlimitDiscard = 0;
+static tibrvQueueLimitPolicy qlimitPolicy = TIBRVQUEUE_DISCARD_FIRST;
+static tibrv_u32        limitExceededCount = 0;
+
+/* Find (or claim) the stats slot for the calling worker thread.  The
+   caller holds statsLock: two workers entering their first callback at
+   the same time would otherwise claim the same slot. */
+static workerStats*
+worker_slot(void)
+{
+#ifdef _WIN32
+    DWORD self = GetCurrentThreadId();
+#else
+    pthread_t self = pthread_self();
+#endif
+    int i;
+
+    for (i = 0; i < MAX_WORKERS; i++)
+    {
+        if (workerTable[i].used)
+        {
+#ifdef _WIN32
+            if (workerTable[i].threadId == self)
+#else
+            if (pthread_equal(workerTable[i].threadId, self))
+#endif
+                return &workerTable[i];
+        }
+        else
+        {
+            workerTable[i].threadId = self;
+            workerTable[i].used = TIBRV_TRUE;
+            return &workerTable[i];
+        }
+    }
+    return &workerTable[0];
+}
+
+/* Record one callback's processing time (seconds).  The caller holds
+   statsLock. */
+static void
+proc_record(tibrv_f64 seconds)
+{
+    tibrv_u32 us = (tibrv_u32)(seconds * 1e6);
+    int bucket = 0;
+
+    while (us > 1 && bucket < PROC_HIST_BUCKETS-1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    procHist[bucket]++;
+    procCount++;
+    if (seconds > procMax)
+        procMax = seconds;
+}
+
+/* Approximate percentile (usec, upper bucket bound). */
+static tibrv_f64
+proc_percentile(tibrv_f64 pct)
+{
+    tibrv_u32 target = (tibrv_u32)((pct / 100.0) * procCount + 0.5);
+    tibrv_u32 seen = 0;
+    int i;
+
+    for (i = 0; i < PROC_HIST_BUCKETS; i++)
+    {
+        seen += procHist[i];
+        if (seen >= target)
+            return (tibrv_f64)(1u << i);
+    }
+    return procMax * 1e6;
+}
+
+/* The queue limit advisory fires once per discard action. */
+static void
+limitExceededCB(tibrvEvent    event,
+                tibrvMsg      message,
+                void *        closure)
+{
+    limitExceededCount++;
+}
+
+/* Periodic per-worker report. */
+static void
+workerStatsCB(tibrvEvent      event,
+              tibrvMsg        message,
+              void *          closure)
+{
+    int i;
+
+    if (qlimitMax > 0 && limitExceededCount > 0)
+        fprintf(stderr, "%s: queue limit hit %u times, ~%u events dropped\n",
+                progname, limitExceededCount,
+                limitExceededCount * qlimitDiscard);
+
+    STATS_LOCK();
+
+    if (procCount == 0)
+    {
+        STATS_UNLOCK();
+        return;
+    }
+
+    fprintf(stderr, "%s: processed %u msgs, processing time (usec) "
+            "p50<=%.0f p90<=%.0f p99<=%.0f max=%.0f\n",
+            progname, procCount,
+            proc_percentile(50.0), proc_percentile(90.0),
+            proc_percentile(99.0), procMax * 1e6);
+
+    for (i = 0; i < MAX_WORKERS; i++)
+    {
+        if (workerTable[i].used)
+            fprintf(stderr, "  worker %d processed %u\n",
+                    i, workerTable[i].processed);
+    }
+
+    STATS_UNLOCK();
+}
+
 
 /*
- * RVFT advisory callback may detect and address problems.
- * This simple routine only prints messages.
+ * Advisory callback.  Advisories are counted instead of printed at
+ * full rate -- during an advisory storm the printing itself used to
+ * fall behind.  At most one summary line per second is emitted,
+ * carrying the count and the most recent advisory subject.
  */
 
+static tibrv_u32        advCount = 0;
+static tibrv_u32        advLastReported = 0;
+static tibrv_i64        advLastReportSec = 0;
+
 void
 advCB(tibrvEvent        event,
       tibrvMsg          message,
       void *            closure)
 {
     tibrv_status        err;
-    const char          *string;
     const char          *name;
+    tibrvMsgDateTime    now;
+
+    advCount++;
 
     err = tibrvMsg_GetSendSubject(message, &name);
+    if (err != TIBRV_OK)
+        return;
 
-    if (err == TIBRV_OK)
+    tibrvMsg_GetCurrentTime(&now);
+    if (now.sec != advLastReportSec)
     {
-        tibrvMsg_ConvertToString(message, &string);
         fprintf(stderr,
-                "#### RVFT ADVISORY: %s \nAdvisory message is: %s\n",
-                name, string);
+                "#### ADVISORY: %u since last report (total %u), last: %s\n",
+                advCount - advLastReported, advCount, name);
+        advLastReportSec = now.sec;
+        advLastReported = advCount;
     }
 
     return;
@@ -112,6 +302,10 @@ my_callback(
     tibrv_bool          listener_registered = TIBRV_FALSE;
 
     tibrv_f64 *delayPtr = (tibrv_f64*)closure;
+    tibrvMsgDateTime procStart, procStop;
+
+    tibrvMsg_GetCurrentTime(&procStart);
+
     /*
      * Get the subject name to which this message was sent.
      */
@@ -233,6 +427,16 @@ my_callback(
          usleep((useconds_t)(*delayPtr * 1000000.0));
        #endif
     }
+
+    /* Attribute this message to the worker thread that ran it and
+     * record the processing time (including any simulated delay). */
+    tibrvMsg_GetCurrentTime(&procStop);
+    STATS_LOCK();
+    worker_slot()->processed++;
+    proc_record((tibrv_f64)(procStop.sec - procStart.sec) +
+                ((tibrv_f64)procStop.nsec -
+                 (tibrv_f64)procStart.nsec)*1e-9);
+    STATS_UNLOCK();
 }
 
 
@@ -243,10 +447,45 @@ usage(void)
     fprintf(stderr,"              [-daemon daemon] [-cmname cmname] \n");
     fprintf(stderr,"              [-workerWeight weight] [-workerTasks tasks] \n");
     fprintf(stderr,"              [-schedulerWeight] [-heartbeat <ms>] [-activation <ms>]\n");
-    fprintf(stderr,"              [-delay <sec>] [-backlogMsgs msgs] [-backlogBytes bytes] subject_list\n");
+    fprintf(stderr,"              [-delay <sec>] [-backlogMsgs msgs] [-backlogBytes bytes]\n");
+    fprintf(stderr,"              [-workers <#threads>]\n");
+    fprintf(stderr,"              [-qlimit max,discard[,first|last|new]] subject_list\n");
     exit(1);
 }
 
+/* Parse the -qlimit value: max,discard[,first|last|new]. */
+void
+parse_qlimit(char* arg)
+{
+    char*   token;
+
+    token = strtok(arg, ",");
+    if (token != NULL)
+    {
+        qlimitMax = (tibrv_u32)atoi(token);
+        token = strtok(NULL, ",");
+    }
+    if (token != NULL)
+    {
+        qlimitDiscard = (tibrv_u32)atoi(token);
+        token = strtok(NULL, ",");
+    }
+    if (token != NULL)
+    {
+        if (strcmp(token, "first") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_FIRST;
+        else if (strcmp(token, "last") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_LAST;
+        else if (strcmp(token, "new") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_NEW;
+        else
+            usage();
+    }
+
+    if (qlimitMax == 0 || qlimitDiscard == 0)
+        usage();
+}
+
 /*********************************************************************/
 /* get_InitParms:  Get from the command line the parameters that can */
 /*                 be passed to tibrvTransport_Create() and          */
@@ -338,11 +577,23 @@ get_InitParms(
         {
             *backlogMsgs = (tibrv_u32)atoi(argv[i+1]);
             i+=2;
-        } else if(strcmp(argv[i], "-backlogBytes") == 0) 
+        } else if(strcmp(argv[i], "-backlogBytes") == 0)
         {
             *backlogBytes = (tibrv_u32)atoi(argv[i+1]);
             i+=2;
         }
+        else if(strcmp(argv[i], "-workers") == 0)
+        {
+            numWorkers = (tibrv_u32)atoi(argv[i+1]);
+            if (numWorkers > MAX_WORKERS)
+                numWorkers = MAX_WORKERS;
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-qlimit") == 0)
+        {
+            parse_qlimit(argv[i+1]);
+            i+=2;
+        }
         else
         {
             usage();
@@ -406,6 +657,10 @@ main(int argc, char** argv)
    // printf("DEBUG: group=%s workerWeight=%u workerTasks=%u schedulerWeight=%u heartbeat=%f activation=%f backlogMsgs=%u\n",
     //  cmnameStr, (unsigned)workerWeight, (unsigned)workerTasks, (unsigned)schedulerWeight,
      //  schedulerHeartbeat, schedulerActivation, (unsigned)backlogMsgs);
+#ifdef _WIN32
+    InitializeCriticalSection(&statsLock);
+#endif
+
     /* Create internal TIB/Rendezvous machinery */
     err = tibrv_Open();
     if (err != TIBRV_OK)
@@ -483,6 +738,103 @@ main(int argc, char** argv)
     #endif
     tibrvTransport_SetDescription(transport, progname);
 
+    /*
+     * In multi-worker mode the DQ member's listeners get a dedicated
+     * queue drained by numWorkers dispatcher threads, plus a periodic
+     * per-worker report on the default queue.
+     */
+    if (numWorkers > 0)
+    {
+        tibrv_u32   w;
+        tibrvEvent  statsTimerId;
+        char        workerName[32];
+
+        err = tibrvQueue_Create(&workerQueue);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to create worker queue --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        for (w = 0; w < numWorkers; w++)
+        {
+            err = tibrvDispatcher_Create(&workerDispatchers[w], workerQueue);
+            if (err != TIBRV_OK)
+            {
+                fprintf(stderr, "%s: Failed to create worker %u --%s\n",
+                        progname, w, tibrvStatus_GetText(err));
+                exit(1);
+            }
+            sprintf(workerName, "dqworker-%u", w);
+            tibrvDispatcher_SetName(workerDispatchers[w], workerName);
+        }
+
+        err = tibrvEvent_CreateTimer(&statsTimerId, TIBRV_DEFAULT_QUEUE,
+                                     workerStatsCB,
+                                     (tibrv_f64)STATS_INTERVAL, NULL);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to create stats timer --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        printf("%s: dispatching with %u worker threads\n",
+               progname, numWorkers);
+    }
+
+    /*
+     * Bound the queue carrying the CM listeners if requested, and
+     * count the resulting discards via the queue limit advisory on
+     * the default queue.
+     */
+    if (qlimitMax > 0)
+    {
+        tibrvEvent limitAdvisoryId;
+
+        err = tibrvQueue_SetLimitPolicy((numWorkers > 0) ?
+                                            workerQueue :
+                                            TIBRV_DEFAULT_QUEUE,
+                                        qlimitPolicy,
+                                        qlimitMax, qlimitDiscard);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to set queue limit policy --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        err = tibrvEvent_CreateListener(&limitAdvisoryId,
+                                        TIBRV_DEFAULT_QUEUE,
+                                        limitExceededCB, transport,
+                                        "_RV.WARN.SYSTEM.QUEUE.LIMIT_EXCEEDED",
+                                        NULL);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to listen for limit advisories --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        /* Without workers there is no periodic report yet; add one so
+           the discard counter is still visible. */
+        if (numWorkers == 0)
+        {
+            tibrvEvent statsTimerId;
+
+            err = tibrvEvent_CreateTimer(&statsTimerId, TIBRV_DEFAULT_QUEUE,
+                                         workerStatsCB,
+                                         (tibrv_f64)STATS_INTERVAL, NULL);
+            if (err != TIBRV_OK)
+            {
+                fprintf(stderr, "%s: Failed to create stats timer --%s\n",
+                        progname, tibrvStatus_GetText(err));
+                exit(1);
+            }
+        }
+    }
+
     /*
      * Listen to each subject.
      */
@@ -492,7 +844,10 @@ main(int argc, char** argv)
 
         printf("%s: Listening to subject %s\n", progname, argv[currentArg]);
 
-        err = tibrvcmEvent_CreateListener(&cmlistenId, TIBRV_DEFAULT_QUEUE,
+        err = tibrvcmEvent_CreateListener(&cmlistenId,
+                                        (numWorkers > 0) ?
+                                            workerQueue :
+                                            TIBRV_DEFAULT_QUEUE,
                                         my_callback, cmtransport,
                                         argv[currentArg], &processingDelay);
 
@@ -555,8 +910,7 @@ main(int argc, char** argv)
     err = tibrvEvent_CreateListener(
               &advId,
               TIBRV_DEFAULT_QUEUE,
-              //advCB,
-              my_callback,
+              advCB,                /* counts; prints at most 1/sec */
               transport,
               //"_RV.INFO.RVCM.QUEUE.SCHEDULER.ACTIVE.MyDQGroup",
              "_RV.*.*.QUEUE.SCHEDULER.>",
@@ -567,8 +921,20 @@ main(int argc, char** argv)
         fprintf(stderr, "%s: Failed to create advisory listener --%s\n",
                 progname, tibrvStatus_GetText(err));
         exit(1);
-    }      
-    #if 0                 
+    }
+
+    /* The shared advisory monitor handles the WARN/ERROR classes on
+     * its own thread, so a slow-consumer or dataloss storm cannot
+     * back up the worker callbacks on the default queue.  The
+     * scheduler listener above stays: it is specific and low-rate.
+     */
+    err = advm_Start(transport, 0);
+    if (err != TIBRV_OK) {
+        fprintf(stderr, "%s: Failed to start advisory monitor --%s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(1);
+    }
+    #if 0
     err = tibrvEvent_CreateListener(
               &advId,
               TIBRV_DEFAULT_QUEUE,
@@ -619,6 +985,8 @@ main(int argc, char** argv)
      * Shouldn't get here.....
      */
 
+    advm_Stop();
+
     tibrv_Close();
 
     return 0;
@@ -24,8 +24,72 @@
 
 //#include "tibrv/tibrv.h"
 //#include "tibrv/ft.h"
+#ifdef _WIN32
 #include <c:\tibco\tibrv\8.7\include\tibrv\tibrv.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\ft.h>
+#else
+#include "tibrv/tibrv.h"
+#include "tibrv/ft.h"
+#endif
+
+#define GROUP_HASH_BUCKETS  (256)   /* power of two */
+
+#define DEFAULT_SNAPSHOT    (10.0)  /* seconds between snapshots */
+
+/*
+ * Multi-group mode (-groups name,name,...).  One monitor per group is
+ * created on a single transport, per-group member state lives in a
+ * hash table updated from the monitor callback, and a periodic timer
+ * prints one consolidated snapshot instead of a line per transition.
+ * One process and one transport replace a monitor process per group.
+ */
+typedef struct groupState
+{
+    char*               name;
+    tibrv_u32           activeMembers;
+    tibrv_u32           transitions;
+    char                lastTransition[TIBRVMSG_DATETIME_STRING_SIZE];
+    struct groupState*  next;           /* hash chain */
+} groupState;
+
+static groupState*      groupTable[GROUP_HASH_BUCKETS];
+static tibrv_u32        numGroups = 0;
+static int              multiGroup = 0;
+static tibrv_f64        snapshotInterval = DEFAULT_SNAPSHOT;
+
+/* djb2 string hash, masked to the bucket count. */
+static tibrv_u32
+group_hash(const char* name)
+{
+    tibrv_u32   h = 5381;
+
+    while (*name)
+        h = (h * 33) + (tibrv_u8)*name++;
+    return h & (GROUP_HASH_BUCKETS - 1);
+}
+
+/* Find the state record for a group, creating it on first sight. */
+static groupState*
+group_lookup(const char* name)
+{
+    tibrv_u32   bucket = group_hash(name);
+    groupState* gs;
+
+    for (gs = groupTable[bucket]; gs != NULL; gs = gs->next)
+    {
+        if (strcmp(gs->name, name) == 0)
+            return gs;
+    }
+
+    gs = (groupState*)calloc(1, sizeof(groupState));
+    gs->name = strdup(name);
+    gs->next = groupTable[bucket];
+    groupTable[bucket] = gs;
+    numGroups++;
+
+    return gs;
+}
+
 /*
  * Fault tolerance monitor callback called when TIBRVFT detects a
  * change in the number of active members in group TIBRVFT_TIME_EXAMPLE.
@@ -40,6 +104,19 @@ monCB(
 {
     static unsigned long        oldNumActives = 0;
 
+    /* In multi-group mode only the hash table is touched here; the
+       snapshot timer does all the printing. */
+    if (multiGroup)
+    {
+        groupState* gs = group_lookup(groupName);
+        char        gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
+
+        gs->activeMembers = numActiveMembers;
+        gs->transitions++;
+        tibrvMsg_GetCurrentTimeString(gs->lastTransition, gmtTime);
+        return;
+    }
+
     printf("Group [%s]: has %d active members (after %s).\n",
            groupName,
            numActiveMembers,
@@ -50,6 +127,38 @@ monCB(
 
     return;
 }
+
+/*
+ * Timer callback printing one consolidated snapshot of every
+ * monitored group.
+ */
+static void
+snapshotCB(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    char        localTime[TIBRVMSG_DATETIME_STRING_SIZE];
+    char        gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
+    groupState* gs;
+    tibrv_u32   bucket;
+
+    tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
+    printf("%s: monitoring %u group(s)\n", localTime, numGroups);
+
+    for (bucket = 0; bucket < GROUP_HASH_BUCKETS; bucket++)
+    {
+        for (gs = groupTable[bucket]; gs != NULL; gs = gs->next)
+        {
+            printf("  [%s]: %u active member(s), %u transition(s)",
+                   gs->name, gs->activeMembers, gs->transitions);
+            if (gs->transitions > 0)
+                printf(", last at %s", gs->lastTransition);
+            printf("\n");
+        }
+    }
+    fflush(stdout);
+}
  /*else if(strcmp(argv[i], "-group") == 0)
         {
             *groupStr = argv[i+1];
@@ -63,6 +172,7 @@ usage(void)
 {
     fprintf(stderr,"tibrvftmon [-service service] [-network network] \n");
     fprintf(stderr,"           [-daemon daemon] [-group name] \n");
+    fprintf(stderr,"           [-groups name,name,...] [-snapshot seconds] \n");
     fprintf(stderr,"           [-ft-lost-interval interval] \n");
     exit(1);
 }
@@ -80,6 +190,7 @@ get_InitParms(
     char**      networkStr,
     char**      daemonStr,
     char**      groupStr,
+    char**      groupsStr,
     tibrv_f64* lostInt)
 {
     int i=1;
@@ -106,6 +217,17 @@ get_InitParms(
             *groupStr = argv[i+1];
             i+=2;
         }
+        else if(strcmp(argv[i], "-groups") == 0)
+        {
+            *groupsStr = argv[i+1];
+            multiGroup = 1;
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-snapshot") == 0)
+        {
+            snapshotInterval = (tibrv_f64)atof(argv[i+1]);
+            i+=2;
+        }
         else if (strcmp(argv[i], "-ft-lost-interval") == 0) // lostInt 옵션 파싱 로직 추가
         {
             *lostInt = (tibrv_f64)atof(argv[i+1]);
@@ -131,13 +253,15 @@ main( int argc, char **argv)
     char*               networkStr = NULL;
     char*               daemonStr  = NULL;
     char *              groupName = "TIBRVFT_TIME_EXAMPLE";
+    char *              groupList = NULL;
 
     /*
      * Parse the arguments for possible optional parameter pairs.
      */
 
-    get_InitParms( argc, argv, &serviceStr, 
-                               &networkStr, &daemonStr, &groupName, &lostInt );
+    get_InitParms( argc, argv, &serviceStr,
+                               &networkStr, &daemonStr, &groupName,
+                               &groupList, &lostInt );
 
     /*
      * Create internal TIB/Rendezvous machinery
@@ -164,6 +288,59 @@ main( int argc, char **argv)
     }
 
 
+    if (multiGroup)
+    {
+        /*
+         * One monitor per listed group, all sharing this transport
+         * and the default queue.  Seed the hash table up front so the
+         * snapshot also shows groups that have not transitioned yet.
+         */
+        char* token;
+
+        for (token = strtok(groupList, ","); token != NULL;
+             token = strtok(NULL, ","))
+        {
+            groupState* gs = group_lookup(token);
+
+            err = tibrvftMonitor_Create(
+                        &monitor,
+                        TIBRV_DEFAULT_QUEUE,
+                        monCB,
+                        transport,
+                        gs->name,
+                        lostInt,
+                        NULL);
+
+            if(err != TIBRV_OK)
+            {
+                fprintf(stderr,
+                        "%s: Failed to start monitor for group %s - %s\n",
+                        argv[0], gs->name, tibrvStatus_GetText(err));
+                exit(1);
+            }
+        }
+
+        if (snapshotInterval > 0.0)
+        {
+            tibrvEvent snapshotTimerId;
+
+            err = tibrvEvent_CreateTimer(&snapshotTimerId,
+                                         TIBRV_DEFAULT_QUEUE,
+                                         snapshotCB,
+                                         snapshotInterval,
+                                         NULL);
+            if(err != TIBRV_OK)
+            {
+                fprintf(stderr,
+                        "%s: Failed to create snapshot timer - %s\n",
+                        argv[0], tibrvStatus_GetText(err));
+                exit(1);
+            }
+        }
+    }
+    else
+    {
+
     /* Set up the monitoring of the RVFT_TIME_EXAMPLE group */
 
     err = tibrvftMonitor_Create(
@@ -184,6 +361,8 @@ main( int argc, char **argv)
         exit(1);
     }
 
+    }
+
     fprintf(stderr,"%s: Waiting for group information...\n", argv[0]);
 
     /* Dispatch loop - dispatches events which have been placed on the event queue */
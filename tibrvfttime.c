@@ -43,14 +43,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
+#define Sleep(ms) usleep((ms)*1000)
+#endif
 
 //#include "tibrv/tibrv.h"
 //#include "tibrv/ft.h"
+#ifdef _WIN32
 #include <c:\tibco\tibrv\8.7\include\tibrv\tibrv.h>
 #include <c:\tibco\tibrv\8.7\include\tibrv\ft.h>
+#else
+#include "tibrv/tibrv.h"
+#include "tibrv/ft.h"
+#endif
+
+#include "advmon.h"
 
 #define SUBJECT "TIBRVFT_TIME"
+
+#define PUB_REPORT_EVERY (30)   /* publishes between cost summaries */
+
 char *progname;
 
 // 메모리 고갈 시뮬레이션을 위한 전역 변수 (한글 주석)
@@ -70,6 +86,18 @@ struct stfdata
     char** memoryBlocks; // 할당된 메모리 블록 포인터 배열 (한글 주석)
     int                 currentBlocks; // 현재 할당된 블록 수 (한글 주석)
     tibrv_bool          isBlocked;
+    tibrvMsg            time_message; /* reused timestamp message */
+    tibrv_u32           pubCount;     /* publish-callback cost stats */
+    tibrv_f64           pubCostTotal;
+    tibrv_f64           pubCostMax;
+    /* Activation-latency instrumentation: timestamps from the FT
+     * instructions through the first successful publish. */
+    tibrvMsgDateTime    prepareStamp;
+    tibrvMsgDateTime    activateStamp;
+    tibrv_bool          sawPrepare;   /* PREPARE preceded ACTIVATE */
+    tibrv_bool          prepared;     /* warm-standby hook has run */
+    tibrv_bool          awaitingFirstPub;
+    char                warmInbox[TIBRV_SUBJECT_MAX];
 };
 
 static char* UsageMessage[]=
@@ -293,6 +321,14 @@ simulateMemoryExhaustion(struct stfdata *datap)
 #endif
 /*
  * Timer callback called every 10 seconds.  Publish time if active.
+ *
+ * The timestamp message is built once in main(); this callback only
+ * updates the binary DATETIME field in place and sends.  No message
+ * construction, no string formatting - subscribers get the native
+ * tibrvMsgDateTime value and format it only when they display it.
+ * This member heartbeats from the same dispatch thread, so every
+ * microsecond spent here delays failover detection; the callback
+ * duration is tracked and summarized every PUB_REPORT_EVERY fires.
  */
 
 static void
@@ -303,7 +339,9 @@ pubTime(tibrvEvent      event,
     tibrv_status        err;
     time_t              curtime;
     tibrvMsgDateTime    tib_time;
-    tibrvMsg            time_message;
+    tibrvMsgDateTime    costStart;
+    tibrvMsgDateTime    costStop;
+    tibrv_f64           cost;
 
     struct stfdata * datap = (struct stfdata *) closure;
 
@@ -321,6 +359,9 @@ pubTime(tibrvEvent      event,
         return;
     }
     #endif
+
+    tibrvMsg_GetCurrentTime(&costStart);
+
     /* Initialize tib_time variables */
     tib_time.nsec = 0;
     tib_time.sec = 0;
@@ -330,53 +371,131 @@ pubTime(tibrvEvent      event,
     /* Set our seconds value */
     tib_time.sec = (tibrv_i64)curtime;
 
-    /*
-     * Create message
-     */
-    err = tibrvMsg_Create(&time_message);
-    if (err != TIBRV_OK)
+    /* Update the preallocated message in place. */
+    err = tibrvMsg_UpdateDateTime(
+            datap->time_message,
+            "DATA",
+            &tib_time);
+
+    if(err != TIBRV_OK)
     {
-        fprintf(stderr, "%s: Failed to create message --%s\n",
-                progname, tibrvStatus_GetText(err));
+        fprintf(stderr, "Error generating timestamp data: %s\n",
+                    tibrvStatus_GetText(err));
     }
     else
     {
-        /* Add the time to the message */
-        err = tibrvMsg_AddDateTime(
-                time_message,
-                "DATA",
-                &tib_time);
+        err = tibrvTransport_Send(datap->transport, datap->time_message);
 
         if(err != TIBRV_OK)
         {
-            fprintf(stderr, "Error generating timestamp data: %s\n",
+            fprintf(stderr, "Error publishing timestamp message: %s\n",
                         tibrvStatus_GetText(err));
         }
-        else
+        else if (datap->awaitingFirstPub)
         {
-            err = tibrvMsg_SetSendSubject(time_message, SUBJECT);
-            if(err != TIBRV_OK)
+            /* First successful publish since ACTIVATE: report the
+               activation latency.  prepare->activate is FT protocol
+               time; activate->first publish is our own cold start. */
+            tibrvMsgDateTime    now;
+            tibrv_f64           actToPub;
+
+            tibrvMsg_GetCurrentTime(&now);
+            actToPub =
+                ((tibrv_f64)(now.sec - datap->activateStamp.sec)) +
+                ((tibrv_f64)(now.nsec - datap->activateStamp.nsec)) / 1.0e9;
+
+            if (datap->sawPrepare)
             {
-                fprintf(stderr, "Error setting send subject: %s\n",
-                        tibrvStatus_GetText(err));
+                tibrv_f64   prepToAct =
+                    ((tibrv_f64)(datap->activateStamp.sec -
+                                 datap->prepareStamp.sec)) +
+                    ((tibrv_f64)(datap->activateStamp.nsec -
+                                 datap->prepareStamp.nsec)) / 1.0e9;
+
+                fprintf(stdout,
+                        "activation latency: prepare->activate %.1f ms, "
+                        "activate->first publish %.1f ms, total %.1f ms\n",
+                        prepToAct * 1.0e3, actToPub * 1.0e3,
+                        (prepToAct + actToPub) * 1.0e3);
             }
             else
             {
-                err = tibrvTransport_Send(datap->transport, time_message);
-
-                if(err != TIBRV_OK)
-                {
-                    fprintf(stderr, "Error publishing timestamp message: %s\n",
-                                tibrvStatus_GetText(err));
-                }
+                fprintf(stdout,
+                        "activation latency: activate->first publish "
+                        "%.1f ms (no prepare received)\n",
+                        actToPub * 1.0e3);
             }
+            fflush(stdout);
+            datap->awaitingFirstPub = TIBRV_FALSE;
         }
-        tibrvMsg_Destroy(time_message);
     }
+
+    tibrvMsg_GetCurrentTime(&costStop);
+    cost = ((tibrv_f64)(costStop.sec - costStart.sec)) +
+           ((tibrv_f64)(costStop.nsec - costStart.nsec)) / 1.0e9;
+
+    datap->pubCount++;
+    datap->pubCostTotal += cost;
+    if (cost > datap->pubCostMax)
+        datap->pubCostMax = cost;
+
+    if ((datap->pubCount % PUB_REPORT_EVERY) == 0)
+    {
+        fprintf(stdout,
+                "publish cost after %u publishes: avg %.1f usec, max %.1f usec\n",
+                datap->pubCount,
+                (datap->pubCostTotal / datap->pubCount) * 1.0e6,
+                datap->pubCostMax * 1.0e6);
+        fflush(stdout);
+    }
+
     return;
 }
 
 
+/*
+ * Warm-standby prepare hook.  Runs on PREPARE_TO_ACTIVATE so that by
+ * the time ACTIVATE arrives this member is publish-ready: the in-place
+ * update path of the reusable timestamp message has been exercised,
+ * and one point-to-point send to our own inbox has warmed the publish
+ * transport's daemon connection without reaching SUBJECT subscribers.
+ * Without this, the first publish after failover pays the cold-start
+ * cost that dominates the observed failover gap.
+ */
+
+static void
+warmStandby(struct stfdata *datap)
+{
+    tibrv_status        err;
+    tibrvMsg            warm_message;
+    tibrvMsgDateTime    tib_time;
+
+    tibrvMsg_GetCurrentTime(&tib_time);
+
+    /* Pre-fault the update path pubTime will take. */
+    tibrvMsg_UpdateDateTime(datap->time_message, "DATA", &tib_time);
+
+    err = tibrvTransport_CreateInbox(datap->transport,
+                                     datap->warmInbox,
+                                     TIBRV_SUBJECT_MAX);
+    if (err == TIBRV_OK)
+        err = tibrvMsg_Create(&warm_message);
+    if (err == TIBRV_OK)
+    {
+        tibrvMsg_SetSendSubject(warm_message, datap->warmInbox);
+        tibrvMsg_AddDateTime(warm_message, "DATA", &tib_time);
+        err = tibrvTransport_Send(datap->transport, warm_message);
+        tibrvMsg_Destroy(warm_message);
+    }
+
+    if (err != TIBRV_OK)
+        fprintf(stderr, "%s: warm-standby prepare failed: %s\n",
+                progname, tibrvStatus_GetText(err));
+    else
+        datap->prepared = TIBRV_TRUE;
+}
+
+
 /*
  * Fault tolerance callback.  RVFT tells the application what to do.
  */
@@ -392,14 +511,22 @@ processInstruction(tibrvftMember        id,
     switch (action)
     {
         case TIBRVFT_PREPARE_TO_ACTIVATE:
-            /* include even if not using this */
 
             fprintf(stdout,"####### PREPARE TO ACTIVATE: %s\n", ftGroupName);
+            tibrvMsg_GetCurrentTime(&datap->prepareStamp);
+            datap->sawPrepare = TIBRV_TRUE;
+            warmStandby(datap);
             break;
 
         case TIBRVFT_ACTIVATE:
 
             fprintf(stdout,"####### ACTIVATE: %s\n", ftGroupName);
+            tibrvMsg_GetCurrentTime(&datap->activateStamp);
+            /* With no prepare interval configured ACTIVATE can arrive
+               cold; warm up now rather than on the first publish. */
+            if (!datap->prepared)
+                warmStandby(datap);
+            datap->awaitingFirstPub = TIBRV_TRUE;
             datap->active = TIBRV_TRUE;
             break;
 
@@ -407,6 +534,11 @@ processInstruction(tibrvftMember        id,
 
             fprintf(stdout,"####### DEACTIVATE: %s\n", ftGroupName);
             datap->active = TIBRV_FALSE;
+            /* Re-warm on the next prepare; state may have gone cold
+               by the time we are asked to take over again. */
+            datap->prepared = TIBRV_FALSE;
+            datap->sawPrepare = TIBRV_FALSE;
+            datap->awaitingFirstPub = TIBRV_FALSE;
             break;
 
         default:
@@ -627,6 +759,29 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f memfaildel=%f activ
     fprintf(stdout, "Subject is %s\n", SUBJECT);
     fprintf(stdout, "Inactive will not publish time\n");
 
+    /*
+     * Build the timestamp message once; pubTime only updates the
+     * DATETIME field and sends, keeping the timer callback short.
+     */
+    {
+        tibrvMsgDateTime    tib_time;
+
+        tib_time.sec = 0;
+        tib_time.nsec = 0;
+
+        err = tibrvMsg_Create(&data.time_message);
+        if (err == TIBRV_OK)
+            err = tibrvMsg_SetSendSubject(data.time_message, SUBJECT);
+        if (err == TIBRV_OK)
+            err = tibrvMsg_AddDateTime(data.time_message, "DATA", &tib_time);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to create timestamp message --%s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(3);
+        }
+    }
+
     err = tibrvEvent_CreateTimer(
                 &data.timerId,
                 TIBRV_DEFAULT_QUEUE,
@@ -699,6 +854,18 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f memfaildel=%f activ
         exit(5);
     }
 
+    /*
+     * The shared advisory monitor counts WARN/ERROR storms on its own
+     * thread so the publish timer and the RVFT instructions on the
+     * default queue keep their cadence.
+     */
+    err = advm_Start(data.transport, 0);
+    if(err != TIBRV_OK)
+    {
+        fprintf(stderr,"%s: Failed to start advisory monitor - %s\n",
+                progname, tibrvStatus_GetText(err));
+        exit(5);
+    }
 
     /*
      * Dispatch loop - dispatches events which have been placed on the event queue
@@ -714,7 +881,9 @@ printf("DEBUG: group=%s Weight=%u heartbeat=%f activation=%f memfaildel=%f activ
      */
 
     tibrvEvent_Destroy(advId);
+    advm_Stop();
     tibrvEvent_Destroy(data.timerId);
+    tibrvMsg_Destroy(data.time_message);
     tibrvftMember_Destroy(data.groupId);
 
     // 메모리 해제 (종료 시) (한글 주석)
@@ -45,11 +45,38 @@ tibrvTransport  transport;
 tibrvMsg        msg;
 char*           progname;
 
+#define MAX_FANOUT      (8)     /* snapshot attempts per subject */
+#define MAX_SUBJECTS    (32)
+#define INITIAL_BACKOFF (0.25)  /* seconds before the second attempt */
+
+/*
+ * Fan-out mode (-fanout attempts).  Each subject's snapshot request is
+ * hedged: the first request goes out immediately and, while no response
+ * has arrived, further requests follow with exponentially growing
+ * backoff, each carrying a distinct reply subject.  The first complete
+ * response wins and the remaining attempts are cancelled.
+ */
+typedef struct snapRequest
+{
+    char                subject[TIBRV_SUBJECT_MAX];
+    tibrvEvent          replyIds[MAX_FANOUT];
+    tibrvEvent          retryTimer;
+    tibrv_u32           attempts;
+    tibrv_bool          answered;
+    tibrv_f64           backoff;
+    tibrvMsgDateTime    firstSent;
+} snapRequest;
+
+static snapRequest      requests[MAX_SUBJECTS];
+static tibrv_u32        numRequests = 0;
+static tibrv_u32        fanoutMax = 0;  /* 0 = classic single request */
+
 void
 usage(void)
 {
     fprintf(stderr,"tibrvinitval [-service service] [-network network] \n");
-    fprintf(stderr,"             [-daemon daemon] <subject> [<subject>]*\n");
+    fprintf(stderr,"             [-daemon daemon] [-fanout attempts] \n");
+    fprintf(stderr,"             <subject> [<subject>]*\n");
     exit(1);
 }
 
@@ -90,6 +117,13 @@ get_InitParms( int argc,
             *daemonStr = argv[i+1];
             i+=2;
         }
+        else if(strcmp(argv[i], "-fanout") == 0)
+        {
+            fanoutMax = (tibrv_u32) atol(argv[i+1]);
+            if (fanoutMax > MAX_FANOUT)
+                fanoutMax = MAX_FANOUT;
+            i+=2;
+        }
         else
         {
             usage();
@@ -169,6 +203,198 @@ send_snap(char *subject)
     return(err);
 }
 
+/*********************************************************************/
+/* fanout_reply_callback:  First complete snapshot response wins.    */
+/*                         Records request-to-first-byte time and    */
+/*                         cancels the remaining attempts.           */
+/*                                                                   */
+/*                         returns void                              */
+/*********************************************************************/
+void fanout_reply_callback (
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    snapRequest*        req = (snapRequest*) closure;
+    const char*         send_subject  = NULL;
+    const char*         theString     = NULL;
+    tibrvMsgDateTime    now;
+    tibrv_f64           elapsed;
+    tibrv_u32           i;
+
+    if (req->answered)          /* late response from a slower attempt */
+        return;
+    req->answered = TIBRV_TRUE;
+
+    tibrvMsg_GetCurrentTime(&now);
+    elapsed = ((tibrv_f64)(now.sec - req->firstSent.sec)) +
+              ((tibrv_f64)(now.nsec - req->firstSent.nsec)) / 1.0e9;
+
+    tibrvMsg_GetSendSubject(message, &send_subject);
+    tibrvMsg_ConvertToString(message, &theString);
+
+    printf("subject=%s, message=%s\n", send_subject, theString);
+    printf("  first response after %.1f msec (attempt %u of %u)\n",
+           elapsed * 1000.0, req->attempts, fanoutMax);
+
+    fflush(stdout);
+
+    /* Cancel the remaining attempts. */
+    for (i = 0; i < req->attempts; i++)
+    {
+        if (req->replyIds[i] != TIBRV_INVALID_ID)
+        {
+            tibrvEvent_Destroy(req->replyIds[i]);
+            req->replyIds[i] = TIBRV_INVALID_ID;
+        }
+    }
+    if (req->retryTimer != TIBRV_INVALID_ID)
+    {
+        tibrvEvent_Destroy(req->retryTimer);
+        req->retryTimer = TIBRV_INVALID_ID;
+    }
+}
+
+/*********************************************************************/
+/* send_snap_attempt:  Sends one hedged _SNAP request on a reply     */
+/*                     subject distinct to this attempt, so a late   */
+/*                     response cannot masquerade as a current one.  */
+/*                                                                   */
+/*                     returns tibrv_status if any tibrv errors occur*/
+/*********************************************************************/
+tibrv_status
+send_snap_attempt(snapRequest *req)
+{
+    tibrv_status        err;
+    char                snap_name[TIBRV_SUBJECT_MAX];
+    char                reply_name[TIBRV_SUBJECT_MAX];
+    tibrv_u32           attempt = req->attempts;
+
+    sprintf(reply_name, "TIBRVIVALUE.%s.%u", req->subject, attempt);
+
+    err = tibrvEvent_CreateListener(&req->replyIds[attempt],
+                                    TIBRV_DEFAULT_QUEUE,
+                                    fanout_reply_callback,
+                                    transport,
+                                    reply_name,
+                                    req);
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr,
+                "%s: Failed to create listener for snap reply: %s --%s\n",
+                progname, reply_name, tibrvStatus_GetText(err));
+        return(err);
+    }
+
+    /* Reuse our message */
+    tibrvMsg_Reset(msg);
+
+    sprintf(snap_name, "_SNAP.%s", req->subject);
+
+    err = tibrvMsg_SetSendSubject(msg, snap_name);
+    if (err == TIBRV_OK)
+        err = tibrvMsg_SetReplySubject(msg, reply_name);
+    if (err == TIBRV_OK)
+        err = tibrvTransport_Send(transport, msg);
+
+    if (err != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Failed to send snap attempt %u --%s\n",
+                progname, attempt, tibrvStatus_GetText(err));
+        return(err);
+    }
+
+    if (attempt == 0)
+        tibrvMsg_GetCurrentTime(&req->firstSent);
+    req->attempts++;
+
+    return(TIBRV_OK);
+}
+
+/*********************************************************************/
+/* fanout_retry_callback:  Backoff timer.  While no response has     */
+/*                         arrived, launches the next attempt and    */
+/*                         doubles the backoff interval.             */
+/*                                                                   */
+/*                         returns void                              */
+/*********************************************************************/
+void fanout_retry_callback (
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    snapRequest*        req = (snapRequest*) closure;
+
+    tibrvEvent_Destroy(req->retryTimer);
+    req->retryTimer = TIBRV_INVALID_ID;
+
+    if (req->answered)
+        return;
+
+    if (req->attempts >= fanoutMax)
+    {
+        fprintf(stderr,
+                "%s: No snapshot response for %s after %u attempts\n",
+                progname, req->subject, req->attempts);
+        return;
+    }
+
+    if (send_snap_attempt(req) != TIBRV_OK)
+        return;
+
+    req->backoff *= 2.0;
+    tibrvEvent_CreateTimer(&req->retryTimer,
+                           TIBRV_DEFAULT_QUEUE,
+                           fanout_retry_callback,
+                           req->backoff,
+                           req);
+}
+
+/*********************************************************************/
+/* start_fanout:  Begins (or restarts) the hedged snapshot sequence  */
+/*                for one subject.                                   */
+/*                                                                   */
+/*                returns tibrv_status if any tibrv errors occur     */
+/*********************************************************************/
+tibrv_status
+start_fanout(snapRequest *req)
+{
+    tibrv_status        err;
+
+    req->answered = TIBRV_FALSE;
+    req->attempts = 0;
+    req->backoff = INITIAL_BACKOFF;
+    req->retryTimer = TIBRV_INVALID_ID;
+
+    err = send_snap_attempt(req);
+
+    if (err == TIBRV_OK && fanoutMax > 1)
+        err = tibrvEvent_CreateTimer(&req->retryTimer,
+                                     TIBRV_DEFAULT_QUEUE,
+                                     fanout_retry_callback,
+                                     req->backoff,
+                                     req);
+    return(err);
+}
+
+/*********************************************************************/
+/* find_request:  Looks up the fan-out state for a subject.          */
+/*                                                                   */
+/*                returns the request, or NULL if not tracked        */
+/*********************************************************************/
+snapRequest*
+find_request(const char *subject)
+{
+    tibrv_u32   i;
+
+    for (i = 0; i < numRequests; i++)
+    {
+        if (strcmp(requests[i].subject, subject) == 0)
+            return(&requests[i]);
+    }
+    return(NULL);
+}
+
 /*********************************************************************/
 /* listen_callback:  Listens on the subject specified on the command */
 /*                   line.  When we hear something, we then send off */
@@ -193,6 +419,42 @@ void listen_callback (
                 "%s: Failed to get send subject in listen callback --%s\n",
                 progname, tibrvStatus_GetText(err));
     }
+    else if (fanoutMax > 0)
+    {
+        /* Restart the hedged sequence for this subject */
+        snapRequest* req = find_request(send_subject);
+
+        if (req != NULL && req->answered)
+            start_fanout(req);
+        else if (req == NULL)
+        {
+            /* A concrete subject heard through a wildcard pattern:
+               register it so it gets its own hedged sequence.  The
+               classic send_snap path is no use here -- its reply
+               listener is only created outside fanout mode, so its
+               snapshot response would be dropped. */
+            if (numRequests < MAX_SUBJECTS)
+            {
+                req = &requests[numRequests++];
+                strcpy(req->subject, send_subject);
+
+                err = start_fanout(req);
+                if (err != TIBRV_OK)
+                    fprintf(stderr,
+                            "%s: Failed to start snapshot requests for "
+                            "subject: %s --%s\n",
+                            progname, send_subject,
+                            tibrvStatus_GetText(err));
+            }
+            else
+            {
+                fprintf(stderr,
+                        "%s: Too many subjects to request a snapshot "
+                        "of %s (max %d)\n",
+                        progname, send_subject, MAX_SUBJECTS);
+            }
+        }
+    }
     else
     {
         /* Call routine to send snap message */
@@ -318,26 +580,45 @@ main(int argc, char **argv)
             exit(1);
         }
 
-        create_replyname(reply_name, argv[currentArg]);
-
-        /* Create the listener for snapped message */
-        err = tibrvEvent_CreateListener(&snapId,
-                                        TIBRV_DEFAULT_QUEUE,
-                                        snap_callback,
-                                        transport,
-                                        reply_name,
-                                        NULL);
-
-        if (err != TIBRV_OK)
+        if (fanoutMax > 0)
         {
-            fprintf(stderr,
-                    "%s: Failed to create listener for snap reply: %s --%s\n",
-                    progname, reply_name, tibrvStatus_GetText(err));
-            exit(1);
+            /* Hedged snapshot sequence for this subject */
+            snapRequest* req;
+
+            if (numRequests >= MAX_SUBJECTS)
+            {
+                fprintf(stderr, "%s: Too many subjects (max %d)\n",
+                        progname, MAX_SUBJECTS);
+                exit(1);
+            }
+            req = &requests[numRequests++];
+            strcpy(req->subject, argv[currentArg]);
+
+            err = start_fanout(req);
+        }
+        else
+        {
+            create_replyname(reply_name, argv[currentArg]);
+
+            /* Create the listener for snapped message */
+            err = tibrvEvent_CreateListener(&snapId,
+                                            TIBRV_DEFAULT_QUEUE,
+                                            snap_callback,
+                                            transport,
+                                            reply_name,
+                                            NULL);
+
+            if (err != TIBRV_OK)
+            {
+                fprintf(stderr,
+                        "%s: Failed to create listener for snap reply: %s --%s\n",
+                        progname, reply_name, tibrvStatus_GetText(err));
+                exit(1);
+            }
+
+            /* Call routine to send snap message */
+            err = send_snap(argv[currentArg]);
         }
-
-        /* Call routine to send snap message */
-        err = send_snap(argv[currentArg]);
 
 
         if (err != TIBRV_OK)
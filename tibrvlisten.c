@@ -45,6 +45,71 @@
 
 #define MIN_PARMS (2)
 
+#define MAX_STAT_SUBJECTS (64)  /* Upper bound on counted subjects */
+
+/* Quiet counting mode (-quiet / -stats N): per-message printing is
+   replaced by per-subject message and byte counters, so the listener
+   can keep up with full-rate subjects instead of being throttled by
+   string conversion and stdout.  One record per command line subject,
+   passed to its listener as the closure. */
+typedef struct
+{
+    const char*         subject;
+    tibrv_u32           msgs;
+    tibrv_u64           bytes;
+    tibrv_u32           lastMsgs;       /* values at previous report */
+    tibrv_u64           lastBytes;
+} subjectStats;
+
+static subjectStats     stats[MAX_STAT_SUBJECTS];
+static int              numStats = 0;
+static int              quietMode = 0;
+static tibrv_u32        statsInterval = 0;  /* seconds, 0 = no reports */
+static tibrv_u32        sampleEvery = 0;    /* print 1 in K messages   */
+
+/* Queue limit policy (-qlimit max,discard[,first|last|new]): bounds
+   the event queue during bursts instead of growing without limit.
+   Discards are observed through the QUEUE.LIMIT_EXCEEDED advisory. */
+static tibrv_u32        qlimitMax = 0;      /* 0 = unbounded (default) */
+static tibrv_u32        qlimitDiscard = 0;
+static tibrvQueueLimitPolicy qlimitPolicy = TIBRVQUEUE_DISCARD_FIRST;
+static tibrv_u32        limitExceededCount = 0;
+
+/* Multiplexed mode (-mux N): listeners are spread round-robin across N
+   queues, each drained by its own dispatcher thread, and messages are
+   counted per received send subject - so a wildcard like "FEED.>"
+   shows which concrete subjects are hot.  Each queue owns a private
+   hash table touched only by its dispatcher thread; no locks on the
+   hot path.  The report timer (on the default queue) merges the
+   tables: it reads the word-sized monotonic counters as momentary
+   snapshots, and new entries are published by writing the bucket head
+   last, so a concurrent walk sees either the old chain or the fully
+   built entry. */
+#define MUX_MAX_QUEUES      (8)
+#define SUBJ_HASH_BUCKETS   (1024)  /* power of two */
+#define MAX_TOP             (32)
+
+typedef struct subjectCount
+{
+    char*                   subject;
+    tibrv_u32               msgs;
+    tibrv_u64               bytes;
+    tibrv_u32               lastMsgs;       /* values at previous report */
+    tibrv_u64               lastBytes;
+    struct subjectCount*    next;           /* hash chain */
+} subjectCount;
+
+typedef struct muxQueue
+{
+    tibrvQueue              queue;
+    tibrvDispatcher         dispatcher;
+    subjectCount*           buckets[SUBJ_HASH_BUCKETS];
+} muxQueue;
+
+static muxQueue         muxQueues[MUX_MAX_QUEUES];
+static tibrv_u32        numMuxQueues = 0;   /* 0 = classic mode */
+static tibrv_u32        topN = 10;          /* -top N report size */
+
 void
 my_callback(
     tibrvEvent          event,
@@ -84,14 +149,284 @@ my_callback(
     fflush(stdout);
 }
 
+/*
+ * Counting callback used in quiet mode.  No string conversion and no
+ * printing on the hot path; only the closure's counters are touched.
+ * With -sample K every Kth message still takes the full print path.
+ */
+void
+stats_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    subjectStats*       stat = (subjectStats*)closure;
+    tibrv_u32           byteSize = 0;
+
+    tibrvMsg_GetByteSize(message, &byteSize);
+
+    stat->msgs++;
+    stat->bytes += byteSize;
+
+    if (sampleEvery > 0 && (stat->msgs % sampleEvery) == 0)
+        my_callback(event, message, closure);
+}
+
+/* djb2 string hash, masked to the bucket count. */
+static tibrv_u32
+subject_hash(const char* subject)
+{
+    tibrv_u32   h = 5381;
+
+    while (*subject)
+        h = (h * 33) + (tibrv_u8)*subject++;
+    return h & (SUBJ_HASH_BUCKETS - 1);
+}
+
+/*
+ * Find the counter record for a send subject in one queue's table,
+ * creating it on first sight.  Called only from the queue's own
+ * dispatcher thread.
+ */
+static subjectCount*
+subject_lookup(muxQueue* mq, const char* subject)
+{
+    tibrv_u32       bucket = subject_hash(subject);
+    subjectCount*   sc;
+
+    for (sc = mq->buckets[bucket]; sc != NULL; sc = sc->next)
+    {
+        if (strcmp(sc->subject, subject) == 0)
+            return sc;
+    }
+
+    sc = (subjectCount*)calloc(1, sizeof(subjectCount));
+    sc->subject = strdup(subject);
+    sc->next = mq->buckets[bucket];
+    /* Publish last, so a concurrent report walk never sees a
+       half-built entry. */
+    mq->buckets[bucket] = sc;
+
+    return sc;
+}
+
+/*
+ * Counting callback for multiplexed mode.  Runs on the owning queue's
+ * dispatcher thread only; no locks, no string conversion, no stdout.
+ */
+void
+mux_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    muxQueue*           mq = (muxQueue*)closure;
+    const char*         send_subject = NULL;
+    subjectCount*       sc;
+    tibrv_u32           byteSize = 0;
+
+    tibrvMsg_GetSendSubject(message, &send_subject);
+    if (send_subject == NULL)
+        return;
+
+    tibrvMsg_GetByteSize(message, &byteSize);
+
+    sc = subject_lookup(mq, send_subject);
+    sc->msgs++;
+    sc->bytes += byteSize;
+}
+
+/*
+ * Advisory callback counting queue limit violations.  Each advisory
+ * means the discard amount of events was dropped under the policy.
+ */
+void
+limit_advisory_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    limitExceededCount++;
+}
+
+/*
+ * Timer callback printing a rate summary for every counted subject.
+ */
+void
+stats_report_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    int                 i;
+    char                localTime[TIBRVMSG_DATETIME_STRING_SIZE];
+    char                gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
+
+    tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
+
+    for (i = 0; i < numStats; i++)
+    {
+        printf("%s: subject=%s msgs=%u bytes=%llu "
+               "(%.0f msgs/sec, %.0f bytes/sec)\n",
+               localTime, stats[i].subject, stats[i].msgs,
+               (unsigned long long)stats[i].bytes,
+               (double)(stats[i].msgs - stats[i].lastMsgs) /
+                   (double)statsInterval,
+               (double)(stats[i].bytes - stats[i].lastBytes) /
+                   (double)statsInterval);
+        stats[i].lastMsgs = stats[i].msgs;
+        stats[i].lastBytes = stats[i].bytes;
+    }
+    if (qlimitMax > 0 && limitExceededCount > 0)
+        printf("%s: queue limit exceeded %u times (~%u events discarded)\n",
+               localTime, limitExceededCount,
+               limitExceededCount * qlimitDiscard);
+    fflush(stdout);
+}
+
+/*
+ * Timer callback for multiplexed mode: merge the per-queue tables and
+ * print the top-N subjects by message rate since the last report.
+ * Entries for the same subject in different tables (overlapping
+ * wildcards) are merged within the candidate set.
+ */
+void
+mux_report_callback(
+    tibrvEvent          event,
+    tibrvMsg            message,
+    void*               closure)
+{
+    subjectCount*       top[MAX_TOP];
+    tibrv_f64           topRate[MAX_TOP];
+    tibrv_f64           topByteRate[MAX_TOP];
+    tibrv_u32           topCount = 0;
+    tibrv_u32           tracked = 0;
+    tibrv_u32           q, b, t;
+    char                localTime[TIBRVMSG_DATETIME_STRING_SIZE];
+    char                gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
+
+    for (q = 0; q < numMuxQueues; q++)
+    {
+        for (b = 0; b < SUBJ_HASH_BUCKETS; b++)
+        {
+            subjectCount* sc;
+
+            for (sc = muxQueues[q].buckets[b]; sc != NULL; sc = sc->next)
+            {
+                tibrv_u32   msgs = sc->msgs;    /* snapshot */
+                tibrv_u64   bytes = sc->bytes;
+                tibrv_f64   rate = (tibrv_f64)(msgs - sc->lastMsgs) /
+                                       (tibrv_f64)statsInterval;
+                tibrv_f64   byteRate = (tibrv_f64)(bytes - sc->lastBytes) /
+                                       (tibrv_f64)statsInterval;
+                tibrv_u32   pos;
+
+                sc->lastMsgs = msgs;
+                sc->lastBytes = bytes;
+                tracked++;
+
+                /* Merge with an existing candidate for this subject */
+                for (t = 0; t < topCount; t++)
+                {
+                    if (strcmp(top[t]->subject, sc->subject) == 0)
+                    {
+                        topRate[t] += rate;
+                        topByteRate[t] += byteRate;
+                        break;
+                    }
+                }
+                if (t < topCount)
+                    continue;
+
+                /* Insertion sort into the candidate list */
+                for (pos = topCount; pos > 0; pos--)
+                {
+                    if (topRate[pos-1] >= rate)
+                        break;
+                    if (pos < topN && pos < MAX_TOP)
+                    {
+                        top[pos] = top[pos-1];
+                        topRate[pos] = topRate[pos-1];
+                        topByteRate[pos] = topByteRate[pos-1];
+                    }
+                }
+                if (pos < topN && pos < MAX_TOP)
+                {
+                    top[pos] = sc;
+                    topRate[pos] = rate;
+                    topByteRate[pos] = byteRate;
+                    if (topCount < topN && topCount < MAX_TOP)
+                        topCount++;
+                }
+            }
+        }
+    }
+
+    tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
+    printf("%s: top %u of %u subjects by rate:\n",
+           localTime, topCount, tracked);
+    for (t = 0; t < topCount; t++)
+        printf("  %-48s %10.0f msgs/sec %14.0f bytes/sec\n",
+               top[t]->subject, topRate[t], topByteRate[t]);
+    if (qlimitMax > 0 && limitExceededCount > 0)
+        printf("%s: queue limit exceeded %u times (~%u events discarded)\n",
+               localTime, limitExceededCount,
+               limitExceededCount * qlimitDiscard);
+    fflush(stdout);
+}
+
 void
 usage(void)
 {
     fprintf(stderr,"tibrvlisten [-service service] [-network network] \n");
-    fprintf(stderr,"            [-daemon daemon] subject_list\n");
+    fprintf(stderr,"            [-daemon daemon] [-quiet] [-stats seconds]\n");
+    fprintf(stderr,"            [-sample K] [-qlimit max,discard[,first|last|new]]\n");
+    fprintf(stderr,"            [-mux queues] [-top N]\n");
+    fprintf(stderr,"            subject_list\n");
     exit(1);
 }
 
+/*
+ * Parse the -qlimit argument: max,discard[,first|last|new].
+ */
+void
+parse_qlimit(
+    char*               arg,
+    const char*         progname)
+{
+    char*               token;
+
+    token = strtok(arg, ",");
+    if (token != NULL)
+    {
+        qlimitMax = (tibrv_u32)strtoul(token, NULL, 10);
+        token = strtok(NULL, ",");
+    }
+    if (token != NULL)
+    {
+        qlimitDiscard = (tibrv_u32)strtoul(token, NULL, 10);
+        token = strtok(NULL, ",");
+    }
+    if (token != NULL)
+    {
+        if (strcmp(token, "first") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_FIRST;
+        else if (strcmp(token, "last") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_LAST;
+        else if (strcmp(token, "new") == 0)
+            qlimitPolicy = TIBRVQUEUE_DISCARD_NEW;
+        else
+            usage();
+    }
+
+    if (qlimitMax == 0 || qlimitDiscard == 0)
+    {
+        fprintf(stderr, "%s: -qlimit requires nonzero max and discard\n",
+                progname);
+        exit(1);
+    }
+}
+
 /*********************************************************************/
 /* get_InitParms:  Get from the command line the parameters that can */
 /*                 be passed to tibrvTransport_Create().             */
@@ -130,6 +465,44 @@ get_InitParms(
             *daemonStr = argv[i+1];
             i+=2;
         }
+        else if(strcmp(argv[i], "-quiet") == 0)
+        {
+            quietMode = 1;
+            i+=1;
+        }
+        else if(strcmp(argv[i], "-stats") == 0)
+        {
+            statsInterval = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-sample") == 0)
+        {
+            sampleEvery = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-qlimit") == 0)
+        {
+            parse_qlimit(argv[i+1], argv[0]);
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-mux") == 0)
+        {
+            numMuxQueues = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            if (numMuxQueues < 1)
+                numMuxQueues = 1;
+            if (numMuxQueues > MUX_MAX_QUEUES)
+                numMuxQueues = MUX_MAX_QUEUES;
+            i+=2;
+        }
+        else if(strcmp(argv[i], "-top") == 0)
+        {
+            topN = (tibrv_u32)strtoul(argv[i+1], NULL, 10);
+            if (topN < 1)
+                topN = 1;
+            if (topN > MAX_TOP)
+                topN = MAX_TOP;
+            i+=2;
+        }
         else
         {
             usage();
@@ -237,18 +610,114 @@ main(int argc, char** argv)
 
     tibrvTransport_SetDescription(transport, progname);
 
+    /*
+     * Bound the event queue if a limit was requested, and count the
+     * resulting discards through the queue limit advisory.
+     */
+    if (qlimitMax > 0)
+    {
+        tibrvEvent limitAdvisoryId;
+
+        err = tibrvQueue_SetLimitPolicy(TIBRV_DEFAULT_QUEUE, qlimitPolicy,
+                                        qlimitMax, qlimitDiscard);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to set queue limit policy: %s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+
+        err = tibrvEvent_CreateListener(&limitAdvisoryId,
+                                        TIBRV_DEFAULT_QUEUE,
+                                        limit_advisory_callback, transport,
+                                        "_RV.WARN.SYSTEM.QUEUE.LIMIT_EXCEEDED",
+                                        NULL);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to listen for limit advisories: %s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(1);
+        }
+    }
+
+    /*
+     * In multiplexed mode, create the queues and their dispatcher
+     * threads before the listeners.
+     */
+    if (numMuxQueues > 0)
+    {
+        tibrv_u32   q;
+        char        muxName[16];
+
+        for (q = 0; q < numMuxQueues; q++)
+        {
+            err = tibrvQueue_Create(&muxQueues[q].queue);
+            if (err == TIBRV_OK && qlimitMax > 0)
+                err = tibrvQueue_SetLimitPolicy(muxQueues[q].queue,
+                                                qlimitPolicy,
+                                                qlimitMax, qlimitDiscard);
+            if (err == TIBRV_OK)
+            {
+                err = tibrvDispatcher_Create(&muxQueues[q].dispatcher,
+                                             muxQueues[q].queue);
+                if (err == TIBRV_OK)
+                {
+                    sprintf(muxName, "MUX-%u", q);
+                    tibrvDispatcher_SetName(muxQueues[q].dispatcher,
+                                            muxName);
+                }
+            }
+            if (err != TIBRV_OK)
+            {
+                fprintf(stderr, "%s: Failed to create mux queue %u: %s\n",
+                        progname, q, tibrvStatus_GetText(err));
+                exit(2);
+            }
+        }
+    }
+
     /*
      * Listen to each subject.
      */
 
     while (currentArg < argc)
     {
+        subjectStats* stat = NULL;
 
         printf("tibrvlisten: Listening to subject %s\n", argv[currentArg]);
 
-        err = tibrvEvent_CreateListener(&listenId, TIBRV_DEFAULT_QUEUE,
-                                        my_callback, transport,
-                                        argv[currentArg], NULL);
+        if (numMuxQueues > 0)
+        {
+            /* Spread listeners round-robin across the mux queues; each
+               counts into its queue's private table. */
+            muxQueue* mq = &muxQueues[numStats % numMuxQueues];
+
+            numStats++;
+            err = tibrvEvent_CreateListener(&listenId, mq->queue,
+                                            mux_callback, transport,
+                                            argv[currentArg], mq);
+        }
+        else
+        {
+            /* In quiet mode each listener counts into its own record. */
+            if (quietMode || statsInterval > 0)
+            {
+                if (numStats >= MAX_STAT_SUBJECTS)
+                {
+                    fprintf(stderr, "%s: Too many subjects (max %d)\n",
+                            progname, MAX_STAT_SUBJECTS);
+                    exit(2);
+                }
+                stat = &stats[numStats++];
+                stat->subject = argv[currentArg];
+            }
+
+            err = tibrvEvent_CreateListener(&listenId, TIBRV_DEFAULT_QUEUE,
+                                            (stat != NULL) ?
+                                                stats_callback : my_callback,
+                                            transport,
+                                            argv[currentArg], stat);
+        }
 
         if (err != TIBRV_OK)
         {
@@ -260,6 +729,28 @@ main(int argc, char** argv)
         currentArg++;
     }
 
+    /* Multiplexed mode always reports; default the interval. */
+    if (numMuxQueues > 0 && statsInterval == 0)
+        statsInterval = 10;
+
+    /* Periodic rate reports in quiet or multiplexed mode. */
+    if (statsInterval > 0)
+    {
+        tibrvEvent statsTimerId;
+
+        err = tibrvEvent_CreateTimer(&statsTimerId, TIBRV_DEFAULT_QUEUE,
+                                     (numMuxQueues > 0) ?
+                                         mux_report_callback :
+                                         stats_report_callback,
+                                     (tibrv_f64)statsInterval, NULL);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to create stats timer: %s\n",
+                    progname, tibrvStatus_GetText(err));
+            exit(2);
+        }
+    }
+
     /*
      * Dispatch loop - dispatches events which have been placed on the event queue
      */
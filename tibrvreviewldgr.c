@@ -51,11 +51,70 @@
 
 #define MIN_PARMS       (4)     /* Must have at least the cmname and ledger file */
 
+#define EXPORT_MAGIC    (0x52564C47)    /* "RVLG"; also marks byte order */
+#define EXPORT_VERSION  (1)
+
 tibrvcmTransport    cmtransport;
 char*               progname;
 tibrv_u32           msgcount = 0;
 tibrv_u32           maxsubj = 0;
 
+/*
+ * Binary export mode (-format binary).  Each reviewed subject is
+ * appended to the output file as a length-prefixed record, and an
+ * index of (subject, record offset, bytes retained), sorted by
+ * subject, is written beside it.  Values are written in host byte
+ * order; the magic number lets readers detect a foreign order.
+ *
+ * Record layout:
+ *   tibrv_u32  record length (bytes following this field)
+ *   tibrv_u16  subject length
+ *   char[]     subject (no terminator)
+ *   tibrv_u64  seqno_last_sent
+ *   tibrv_u64  unconfirmed messages retained (total_msgs)
+ *   tibrv_u64  bytes retained (total_size)
+ */
+typedef struct
+{
+    char*               subject;
+    tibrv_u64           offset;         /* record offset in data file */
+    tibrv_u64           size;           /* bytes retained */
+} indexEntry;
+
+static int              binaryFormat = 0;
+static char*            outputStr = "ledger.export";
+static FILE*            binfp = NULL;
+static indexEntry*      indexEntries = NULL;
+static tibrv_u32        indexCount = 0;
+static tibrv_u32        indexAlloc = 0;
+
+/*
+ * Backlog analysis mode (-analyze).  The review records are aggregated
+ * into a backlog report: total unconfirmed messages and bytes, the top
+ * offending subjects, and, when a -baseline snapshot from a previous
+ * run is given, per-subject and total deltas.  The snapshot is
+ * rewritten after each run so a cron job can diff against its last
+ * invocation with a single file.  When -alert is set and backlog
+ * growth in messages reaches the threshold, the program exits with
+ * status 2 so the cron wrapper can page.
+ *
+ * Snapshot format is one text line per subject:  msgs bytes subject.
+ */
+typedef struct
+{
+    char*               subject;
+    tibrv_u64           msgs;           /* unconfirmed messages retained */
+    tibrv_u64           bytes;          /* bytes retained */
+} backlogEntry;
+
+static int              analyzeMode = 0;
+static char*            baselineStr = NULL;
+static tibrv_u32        topOffenders = 10;
+static tibrv_i64        alertGrowth = -1;       /* msgs; < 0 disables */
+static backlogEntry*    backlog = NULL;
+static tibrv_u32        backlogCount = 0;
+static tibrv_u32        backlogAlloc = 0;
+
 /*
  * Display program usage information if incorrect or insufficient command line
  * arguments are supplied.
@@ -65,7 +124,10 @@ usage(void)
 {
     fprintf(stderr,"tibrvreviewldgr  [-service service] [-network network] \n");
     fprintf(stderr,"                 [-daemon  daemon]  [-ledger  filename]\n");
-    fprintf(stderr,"                 [-cmname  cmname]  [-maxsubj #subjects]  subject \n");
+    fprintf(stderr,"                 [-cmname  cmname]  [-maxsubj #subjects]\n");
+    fprintf(stderr,"                 [-format  text|binary]  [-output filename]\n");
+    fprintf(stderr,"                 [-analyze] [-baseline filename]\n");
+    fprintf(stderr,"                 [-top #subjects]  [-alert #msgs]  subject \n");
     exit(1);
 }
 
@@ -135,12 +197,61 @@ get_InitParms(
             maxsubj = atoi(argv[i+1]);
             i+=2;
         }
+        else if (strcmp(argv[i], "-format") == 0)
+        {
+            /* Review output format: text (default) or binary export. */
+            if (strcmp(argv[i+1], "binary") == 0)
+                binaryFormat = 1;
+            else if (strcmp(argv[i+1], "text") != 0)
+                usage();
+            i+=2;
+        }
+        else if (strcmp(argv[i], "-output") == 0)
+        {
+            /* Save string value for the binary export file name. */
+            outputStr = argv[i+1];
+            i+=2;
+        }
+        else if (strcmp(argv[i], "-analyze") == 0)
+        {
+            /* Aggregate the review into a backlog report. */
+            analyzeMode = 1;
+            i+=1;
+        }
+        else if (strcmp(argv[i], "-baseline") == 0)
+        {
+            /* Save string value for the backlog snapshot file name. */
+            baselineStr = argv[i+1];
+            i+=2;
+        }
+        else if (strcmp(argv[i], "-top") == 0)
+        {
+            /* Save integer value for the number of top offenders. */
+            topOffenders = atoi(argv[i+1]);
+            if (topOffenders < 1)
+                topOffenders = 1;
+            i+=2;
+        }
+        else if (strcmp(argv[i], "-alert") == 0)
+        {
+            /* Save integer backlog growth threshold in messages. */
+            alertGrowth = atoll(argv[i+1]);
+            i+=2;
+        }
         else
         {
             usage();
         }
     }
 
+    /* -analyze takes no value, so as the last option it falls out of
+       the pair loop above. */
+    if (i < argc && strcmp(argv[i], "-analyze") == 0)
+    {
+        analyzeMode = 1;
+        i++;
+    }
+
     if (i+1 <= argc)
     {
         /* If there is a parameter remaining, save it as the subject string. */
@@ -150,6 +261,386 @@ get_InitParms(
     return( i );
 }
 
+/*
+ * Append one length-prefixed record to the binary export file and
+ * remember its offset and size for the subject index.  No printf on
+ * this path; on large ledgers text conversion dominates review time.
+ */
+void
+export_record(
+    const char*         subject,
+    tibrv_u64           seqno_last_sent,
+    tibrv_u64           total_msgs,
+    tibrv_u64           total_size)
+{
+    tibrv_u16           slen = (tibrv_u16)strlen(subject);
+    tibrv_u32           reclen;
+    long                offset;
+    indexEntry*         entry;
+
+    offset = ftell(binfp);
+
+    reclen = sizeof(slen) + slen + 3*sizeof(tibrv_u64);
+
+    if (fwrite(&reclen, sizeof(reclen), 1, binfp) != 1 ||
+        fwrite(&slen, sizeof(slen), 1, binfp) != 1 ||
+        fwrite(subject, 1, slen, binfp) != slen ||
+        fwrite(&seqno_last_sent, sizeof(tibrv_u64), 1, binfp) != 1 ||
+        fwrite(&total_msgs, sizeof(tibrv_u64), 1, binfp) != 1 ||
+        fwrite(&total_size, sizeof(tibrv_u64), 1, binfp) != 1)
+    {
+        fprintf(stderr, "%s: Failed to write export record.\n", progname);
+        exit(1);
+    }
+
+    /* Grow the index by doubling; ledgers can hold millions of
+       subjects and per-entry realloc would dominate. */
+    if (indexCount == indexAlloc)
+    {
+        indexAlloc = (indexAlloc == 0) ? 1024 : indexAlloc*2;
+        indexEntries = (indexEntry*)realloc(indexEntries,
+                                            indexAlloc*sizeof(indexEntry));
+        if (indexEntries == NULL)
+        {
+            fprintf(stderr, "%s: Failed to grow subject index.\n", progname);
+            exit(1);
+        }
+    }
+
+    entry = &indexEntries[indexCount++];
+    entry->subject = strdup(subject);
+    entry->offset = (tibrv_u64)offset;
+    entry->size = total_size;
+}
+
+/*
+ * Comparison routine for sorting index entries by subject.
+ */
+int
+compare_index_entries(
+    const void*         a,
+    const void*         b)
+{
+    return strcmp(((const indexEntry*)a)->subject,
+                  ((const indexEntry*)b)->subject);
+}
+
+/*
+ * Sort the collected index entries by subject and write them to
+ * <output>.idx:  magic, version, entry count, then per entry the
+ * subject length, subject, record offset and bytes retained.
+ */
+void
+write_index(void)
+{
+    char*               idxname;
+    FILE*               idxfp;
+    tibrv_u32           magic = EXPORT_MAGIC;
+    tibrv_u32           version = EXPORT_VERSION;
+    tibrv_u32           i;
+
+    idxname = (char*)malloc(strlen(outputStr) + 5);
+    sprintf(idxname, "%s.idx", outputStr);
+
+    if ((idxfp = fopen(idxname, "wb")) == NULL)
+    {
+        fprintf(stderr, "%s: Failed to create index file %s.\n",
+                progname, idxname);
+        exit(1);
+    }
+
+    qsort(indexEntries, indexCount, sizeof(indexEntry),
+          compare_index_entries);
+
+    if (fwrite(&magic, sizeof(magic), 1, idxfp) != 1 ||
+        fwrite(&version, sizeof(version), 1, idxfp) != 1 ||
+        fwrite(&indexCount, sizeof(indexCount), 1, idxfp) != 1)
+    {
+        fprintf(stderr, "%s: Failed to write index header.\n", progname);
+        exit(1);
+    }
+
+    for (i = 0; i < indexCount; i++)
+    {
+        indexEntry* entry = &indexEntries[i];
+        tibrv_u16   slen = (tibrv_u16)strlen(entry->subject);
+
+        if (fwrite(&slen, sizeof(slen), 1, idxfp) != 1 ||
+            fwrite(entry->subject, 1, slen, idxfp) != slen ||
+            fwrite(&entry->offset, sizeof(tibrv_u64), 1, idxfp) != 1 ||
+            fwrite(&entry->size, sizeof(tibrv_u64), 1, idxfp) != 1)
+        {
+            fprintf(stderr, "%s: Failed to write index entry.\n", progname);
+            exit(1);
+        }
+        free(entry->subject);
+    }
+
+    fclose(idxfp);
+    printf("Wrote subject index %s (%u entries).\n", idxname, indexCount);
+    free(idxname);
+    free(indexEntries);
+}
+
+/*
+ * Remember one reviewed subject for the backlog report.  Like the
+ * export index, the array grows by doubling.
+ */
+void
+record_backlog(
+    const char*         subject,
+    tibrv_u64           total_msgs,
+    tibrv_u64           total_size)
+{
+    backlogEntry*       entry;
+
+    if (backlogCount == backlogAlloc)
+    {
+        backlogAlloc = (backlogAlloc == 0) ? 1024 : backlogAlloc*2;
+        backlog = (backlogEntry*)realloc(backlog,
+                                         backlogAlloc*sizeof(backlogEntry));
+        if (backlog == NULL)
+        {
+            fprintf(stderr, "%s: Failed to grow backlog table.\n", progname);
+            exit(1);
+        }
+    }
+
+    entry = &backlog[backlogCount++];
+    entry->subject = strdup(subject);
+    entry->msgs = total_msgs;
+    entry->bytes = total_size;
+}
+
+/*
+ * Comparison routines for the backlog report: by subject for the
+ * baseline merge, by retained messages (descending) for the offender
+ * list.
+ */
+int
+compare_backlog_subjects(
+    const void*         a,
+    const void*         b)
+{
+    return strcmp(((const backlogEntry*)a)->subject,
+                  ((const backlogEntry*)b)->subject);
+}
+
+int
+compare_backlog_msgs(
+    const void*         a,
+    const void*         b)
+{
+    tibrv_u64           am = ((const backlogEntry*)a)->msgs;
+    tibrv_u64           bm = ((const backlogEntry*)b)->msgs;
+
+    if (am != bm)
+        return (am < bm) ? 1 : -1;
+    return compare_backlog_subjects(a, b);
+}
+
+/*
+ * Read a backlog snapshot written by a previous -analyze run.  Returns
+ * the entry count, sorted by subject; a missing file is not an error
+ * (the first cron run has no baseline yet).
+ */
+tibrv_u32
+load_baseline(
+    backlogEntry**      entries)
+{
+    FILE*               fp;
+    backlogEntry*       base = NULL;
+    tibrv_u32           count = 0;
+    tibrv_u32           alloc = 0;
+    unsigned long long  msgs;
+    unsigned long long  bytes;
+    char                subject[1024];
+
+    *entries = NULL;
+    if ((fp = fopen(baselineStr, "r")) == NULL)
+        return (0);
+
+    while (fscanf(fp, "%llu %llu %1023s", &msgs, &bytes, subject) == 3)
+    {
+        if (count == alloc)
+        {
+            alloc = (alloc == 0) ? 1024 : alloc*2;
+            base = (backlogEntry*)realloc(base,
+                                          alloc*sizeof(backlogEntry));
+            if (base == NULL)
+            {
+                fprintf(stderr, "%s: Failed to grow baseline table.\n",
+                        progname);
+                exit(1);
+            }
+        }
+        base[count].subject = strdup(subject);
+        base[count].msgs = (tibrv_u64)msgs;
+        base[count].bytes = (tibrv_u64)bytes;
+        count++;
+    }
+    fclose(fp);
+
+    qsort(base, count, sizeof(backlogEntry), compare_backlog_subjects);
+    *entries = base;
+    return (count);
+}
+
+/*
+ * Rewrite the baseline snapshot with the current run so the next
+ * invocation diffs against this one.
+ */
+void
+save_baseline(void)
+{
+    FILE*               fp;
+    tibrv_u32           i;
+
+    if ((fp = fopen(baselineStr, "w")) == NULL)
+    {
+        fprintf(stderr, "%s: Failed to write snapshot file %s.\n",
+                progname, baselineStr);
+        exit(1);
+    }
+    for (i = 0; i < backlogCount; i++)
+        fprintf(fp, "%llu %llu %s\n", backlog[i].msgs, backlog[i].bytes,
+                backlog[i].subject);
+    fclose(fp);
+}
+
+/*
+ * Produce the backlog report: totals, deltas against the baseline when
+ * one is present, and the top offenders.  Returns the process exit
+ * status:  2 when message growth reaches the -alert threshold, else 0.
+ */
+int
+analyze_report(void)
+{
+    backlogEntry*       base = NULL;
+    tibrv_u32           baseCount = 0;
+    tibrv_u64           totalMsgs = 0;
+    tibrv_u64           totalBytes = 0;
+    tibrv_u64           baseMsgs = 0;
+    tibrv_u64           baseBytes = 0;
+    tibrv_i64           msgsGrowth;
+    tibrv_i64           bytesGrowth;
+    tibrv_u32           i;
+    tibrv_u32           j;
+    tibrv_u32           n;
+    int                 exitStatus = 0;
+
+    qsort(backlog, backlogCount, sizeof(backlogEntry),
+          compare_backlog_subjects);
+
+    for (i = 0; i < backlogCount; i++)
+    {
+        totalMsgs += backlog[i].msgs;
+        totalBytes += backlog[i].bytes;
+    }
+
+    printf("\nBacklog: %u subjects retain %llu messages in %llu bytes.\n",
+           backlogCount, totalMsgs, totalBytes);
+
+    if (baselineStr != NULL)
+        baseCount = load_baseline(&base);
+
+    if (baseCount > 0)
+    {
+        for (i = 0; i < baseCount; i++)
+        {
+            baseMsgs += base[i].msgs;
+            baseBytes += base[i].bytes;
+        }
+        msgsGrowth = (tibrv_i64)totalMsgs - (tibrv_i64)baseMsgs;
+        bytesGrowth = (tibrv_i64)totalBytes - (tibrv_i64)baseBytes;
+
+        printf("Since last run: %+lld messages, %+lld bytes.\n",
+               msgsGrowth, bytesGrowth);
+
+        /* Walk both subject-sorted lists in step and report the
+           per-subject movers. */
+        i = 0;
+        j = 0;
+        while (i < backlogCount || j < baseCount)
+        {
+            int cmp;
+
+            if (i >= backlogCount)
+                cmp = 1;
+            else if (j >= baseCount)
+                cmp = -1;
+            else
+                cmp = strcmp(backlog[i].subject, base[j].subject);
+
+            if (cmp < 0)
+            {
+                printf("  new:     %-45s %10llu msgs %14llu bytes\n",
+                       backlog[i].subject, backlog[i].msgs,
+                       backlog[i].bytes);
+                i++;
+            }
+            else if (cmp > 0)
+            {
+                printf("  cleared: %-45s %10llu msgs %14llu bytes\n",
+                       base[j].subject, base[j].msgs, base[j].bytes);
+                j++;
+            }
+            else
+            {
+                if (backlog[i].msgs != base[j].msgs ||
+                    backlog[i].bytes != base[j].bytes)
+                {
+                    printf("  delta:   %-45s %+10lld msgs %+14lld bytes\n",
+                           backlog[i].subject,
+                           (tibrv_i64)backlog[i].msgs -
+                               (tibrv_i64)base[j].msgs,
+                           (tibrv_i64)backlog[i].bytes -
+                               (tibrv_i64)base[j].bytes);
+                }
+                i++;
+                j++;
+            }
+        }
+
+        if ((alertGrowth >= 0) && (msgsGrowth >= alertGrowth))
+        {
+            printf("ALERT: backlog grew by %lld messages "
+                   "(threshold %lld).\n", msgsGrowth, alertGrowth);
+            exitStatus = 2;
+        }
+    }
+    else if (baselineStr != NULL)
+    {
+        printf("No baseline snapshot %s; this run becomes the baseline.\n",
+               baselineStr);
+    }
+
+    /*
+     * Top offenders by retained messages.
+     */
+    qsort(backlog, backlogCount, sizeof(backlogEntry),
+          compare_backlog_msgs);
+    n = (backlogCount < topOffenders) ? backlogCount : topOffenders;
+    if (n > 0)
+        printf("Top %u subjects by retained messages:\n", n);
+    for (i = 0; i < n; i++)
+        printf("  %-45s %10llu msgs %14llu bytes\n",
+               backlog[i].subject, backlog[i].msgs, backlog[i].bytes);
+    fflush(stdout);
+
+    if (baselineStr != NULL)
+        save_baseline();
+
+    for (i = 0; i < baseCount; i++)
+        free(base[i].subject);
+    free(base);
+    for (i = 0; i < backlogCount; i++)
+        free(backlog[i].subject);
+    free(backlog);
+
+    return (exitStatus);
+}
+
 /*
  * Ledger review callback--  tibrvcmTransport_ReviewLedger calls this routine
  * once for each matching subject in the ledger file on which the cm transport
@@ -207,6 +698,35 @@ review_callback(
                     progname, tibrvStatus_GetText(err));
         exit(1);
     }
+    /*
+     * In analyze mode accumulate quietly; the backlog report prints
+     * once the review completes.
+     */
+    if (analyzeMode)
+    {
+        record_backlog(ldgr_subject, total_msgs, total_size);
+
+        if (!binaryFormat)
+        {
+            if ((maxsubj > 0) && (msgcount >= maxsubj))
+                return (progname);
+            return (NULL);
+        }
+    }
+
+    /*
+     * In binary mode stream the record to the export file and return;
+     * the stored totals are the unconfirmed backlog for the subject.
+     */
+    if (binaryFormat)
+    {
+        export_record(ldgr_subject, seqno_last_sent, total_msgs, total_size);
+
+        if ((maxsubj > 0) && (msgcount >= maxsubj))
+            return (progname);
+        return (NULL);
+    }
+
     printf("\nSubj: %-45s Last seqno sent: %10llu\n", ldgr_subject, seqno_last_sent);
 
     /*
@@ -268,6 +788,7 @@ main(int argc, char **argv)
     char*               cmnameStr  = NULL;
     char*               subjectStr = ">";
     FILE                *fptr = NULL;
+    int                 exitStatus = 0;
 
     progname = argv[0];
 
@@ -362,6 +883,29 @@ main(int argc, char **argv)
     tibrvTransport_SetDescription(transport, progname);
 
 
+    /*
+     * In binary mode open the export file and write its header before
+     * the review starts streaming records into it.
+     */
+    if (binaryFormat)
+    {
+        tibrv_u32 magic = EXPORT_MAGIC;
+        tibrv_u32 version = EXPORT_VERSION;
+
+        if ((binfp = fopen(outputStr, "wb")) == NULL)
+        {
+            fprintf(stderr, "%s: Failed to create export file %s.\n",
+                    progname, outputStr);
+            exit(1);
+        }
+        if (fwrite(&magic, sizeof(magic), 1, binfp) != 1 ||
+            fwrite(&version, sizeof(version), 1, binfp) != 1)
+        {
+            fprintf(stderr, "%s: Failed to write export header.\n", progname);
+            exit(1);
+        }
+    }
+
     /*
      * Report the file name and subject from the command line,
      */
@@ -382,6 +926,24 @@ main(int argc, char **argv)
         exit(1);
     }
 
+    /*
+     * Finish the binary export: close the data file and write the
+     * sorted subject index beside it.
+     */
+    if (binaryFormat)
+    {
+        fclose(binfp);
+        printf("\nExported %u subjects to %s.\n", indexCount, outputStr);
+        write_index();
+    }
+
+    /*
+     * Produce the backlog report.  Its exit status carries the growth
+     * alert to the cron wrapper.
+     */
+    if (analyzeMode)
+        exitStatus = analyze_report();
+
     /*
      * Report the number of matches.  If maximum subject count has been reached,
      * report as stopped.
@@ -404,5 +966,5 @@ main(int argc, char **argv)
      */
     tibrv_Close();
 
-    exit(0);
+    exit(exitStatus);
 }
@@ -27,6 +27,12 @@
  *                                  counts -- if non-zero, a message is
  *                                  printed every <n> response messages
  *                                  sent.
+ *   workers         0              optional number of dispatcher threads
+ *                                  servicing client requests -- if
+ *                                  non-zero, requests are delivered to a
+ *                                  dedicated queue drained by <n>
+ *                                  dispatcher threads, each replying on
+ *                                  its own transport.
  *
  * Examples:
  *
@@ -45,6 +51,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "tibrv/tibrv.h"
 
@@ -79,13 +86,52 @@ static tibrvMsg             search_reply;   /* search_reply has global
                                                but send it from
                                                searchCallback(). */
 
-static tibrv_bool           new_msg = TIBRV_FALSE; /* use a new message for
-                                               reply if true;
+static tibrvMsg             request_reply;  /* reply to client requests,
+                                               built once in main();
+                                               requestCallback() only
+                                               updates the per-request
+                                               fields in place.  Used
+                                               only outside worker mode;
+                                               each worker has its own
+                                               copy because tibrvMsg is
+                                               not thread-safe. */
+
+static tibrv_bool           new_msg = TIBRV_TRUE; /* reply with the reusable
+                                               reply message if true;
                                                otherwise put sum
                                                in received msg. */
 
 static tibrv_u32            requests = 0;
 
+/* Callback service-time gauges for -stats.  Like the worker served
+   counters these are updated without a guard in worker mode. */
+static tibrv_bool           show_stats = TIBRV_FALSE;
+static tibrv_f64            svc_total = 0.0;
+static tibrv_f64            svc_max = 0.0;
+
+#define MAX_WORKERS         64              /* Upper bound for -workers */
+
+/* One entry per worker thread: its reply transport, its dispatcher, its
+   own preallocated reply message and a count of requests it has served.
+   The reply messages keep concurrent dispatcher threads from updating
+   and sending the same tibrvMsg, which is not thread-safe.  A record is
+   bound to its dispatcher thread on the thread's first callback; the
+   claim and the served counters are guarded by workerLock. */
+typedef struct
+{
+    tibrvTransport          transport;
+    tibrvDispatcher         dispatcher;
+    tibrvMsg                reply;
+    tibrv_u32               served;
+    pthread_t               threadId;
+    tibrv_bool              used;
+} workerRecord;
+
+static workerRecord         workers[MAX_WORKERS];
+static tibrv_u32            num_workers = 0;
+static pthread_mutex_t      workerLock = PTHREAD_MUTEX_INITIALIZER;
+static tibrvQueue           request_queue = TIBRV_INVALID_ID;
+
 char                        localTime[TIBRVMSG_DATETIME_STRING_SIZE];
 char                        gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
 
@@ -97,6 +143,7 @@ usage(void)
 {
     fprintf(stderr, "tibrvserver_direct  [-service <service>] [-network <network>]\n");
     fprintf(stderr, "                    [-daemon  <daemon>]  [-status  <#msgs>]\n");
+    fprintf(stderr, "                    [-workers <#threads>] [-stats]\n");
     exit(1);
 }
 
@@ -162,6 +209,18 @@ getParameters(int           argc,
             *status_frq = (tibrv_u32) atol(argv[i+1]);
             i += 2;
         }
+        else if (strcmp(argv[i], "-workers") == 0)
+        {
+            num_workers = (tibrv_u32) atol(argv[i+1]);
+            if (num_workers > MAX_WORKERS)
+                num_workers = MAX_WORKERS;
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-stats") == 0)
+        {
+            show_stats = TIBRV_TRUE;
+            i += 1;
+        }
         else
         {
             /* If there is some other parameter with a value,
@@ -169,6 +228,14 @@ getParameters(int           argc,
             usage();
         }
     }
+
+    /* A value-less flag as the last argument falls out of the loop. */
+    if ((i < argc) && (strcmp(argv[i], "-stats") == 0))
+    {
+        show_stats = TIBRV_TRUE;
+        i += 1;
+    }
+
     return i;   /* return the index of the next argument */
 }
 
@@ -199,6 +266,66 @@ searchCallback(tibrvEvent event,
 }
 
 
+/* Return the calling dispatcher thread's worker record, claiming the
+   next free slot on the thread's first callback.  The claim runs under
+   workerLock so two threads entering their first callback at the same
+   time cannot pick the same slot; after that each thread always maps
+   back to its own record, so its reply transport and preallocated
+   reply message are never shared between threads. */
+static workerRecord*
+worker_slot(void)
+{
+    pthread_t       self = pthread_self();
+    workerRecord*   slot = &workers[0];
+    tibrv_u32       i;
+
+    pthread_mutex_lock(&workerLock);
+    for (i = 0; i < num_workers; i++)
+    {
+        if (workers[i].used)
+        {
+            if (pthread_equal(workers[i].threadId, self))
+            {
+                slot = &workers[i];
+                break;
+            }
+        }
+        else
+        {
+            workers[i].threadId = self;
+            workers[i].used = TIBRV_TRUE;
+            slot = &workers[i];
+            break;
+        }
+    }
+    slot->served++;
+    pthread_mutex_unlock(&workerLock);
+
+    return slot;
+}
+
+
+/* Build a reply message for client requests with its fields seeded;
+   requestCallback() only updates "sum" and "ts" in place. */
+static tibrv_status
+createRequestReply(tibrvMsg* reply)
+{
+    tibrv_status        return_code;
+    tibrvMsgDateTime    reply_time;
+
+    reply_time.sec = 0;
+    reply_time.nsec = 0;
+
+    return_code = tibrvMsg_Create(reply);
+    if (return_code == TIBRV_OK)
+        return_code = tibrvMsg_UpdateU32(*reply, "sum", 0);
+    if (return_code == TIBRV_OK)
+        return_code = tibrvMsg_UpdateDateTime(*reply, "ts", &reply_time);
+
+    return return_code;
+}
+
+
 /* This callback is executed when a client request is received.  It adds the
    values in the request, puts the result in a message, and sends it as
    a reply. */
@@ -207,9 +334,28 @@ requestCallback(tibrvEvent event,
                 tibrvMsg   message,
                 void*      closure)
 {
-    tibrv_status    return_code = TIBRV_OK;
-    tibrvMsg        request_reply;
-    tibrv_u32       x, y, sum;
+    tibrv_status        return_code = TIBRV_OK;
+    tibrv_u32           x, y, sum;
+    tibrvTransport      reply_transport = transport;
+    tibrvMsg            reply = request_reply;
+    tibrvMsgDateTime    reply_time;
+    tibrvMsgDateTime    svc_start;
+    tibrvMsgDateTime    svc_stop;
+
+    if (show_stats)
+        tibrvMsg_GetCurrentTime(&svc_start);
+
+    /* In worker mode, use the record bound to this dispatcher thread;
+       the served counters report how the queue spread the requests
+       across the workers.  Each worker has its own reply transport and
+       preallocated reply message, so no two dispatcher threads ever
+       update or send the same tibrvMsg. */
+    if (num_workers > 0)
+    {
+        workerRecord* worker = worker_slot();
+        reply_transport = worker->transport;
+        reply = worker->reply;
+    }
 
     /* Get the values in field "x" */
     return_code = tibrvMsg_GetU32(message, "x", &x);;
@@ -236,25 +382,17 @@ requestCallback(tibrvEvent event,
     /* Add the values and update the reply message with the sum. */
     sum = x + y;
 
-    /* If new_msg is true, create a new message, add the sum as a field, send it,
-       and destroy it.  If new_msg is false, update or insert the sum field and
-       send.  In this case we do not destroy the message because an inbound
-       message in a callback is owned by Rendezvous. */
+    /* If new_msg is true, update the per-request fields of the reply
+       message that was built once in main() (or this worker's own copy
+       in worker mode) and send it; nothing is created, formatted or
+       destroyed per request.  If new_msg is false, update or insert the
+       sum field in the received message and send.  In this case we do
+       not destroy the message because an inbound message in a callback
+       is owned by Rendezvous. */
     if (new_msg)
     {
-        /* Create a new reply message. */
-        return_code = tibrvMsg_Create(&request_reply);
-        if (return_code != TIBRV_OK)
-        {
-            fprintf(stderr,
-                    "%s failed to initialize a reply to a client request: %s\n",
-                    program_name,
-                    tibrvStatus_GetText(return_code));
-            exit(1);
-        }
-
         /* Put the sum in the reply message. */
-        return_code = tibrvMsg_UpdateU32(request_reply, "sum", sum);
+        return_code = tibrvMsg_UpdateU32(reply, "sum", sum);
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
@@ -264,23 +402,25 @@ requestCallback(tibrvEvent event,
             exit(1);
         }
 
-        /* Send a reply to the request message. */
-        return_code = tibrvTransport_SendReply(transport, request_reply, message);
+        /* Stamp the reply with a binary timestamp; the receiver can
+           format it if and when it displays it. */
+        tibrvMsg_GetCurrentTime(&reply_time);
+        return_code = tibrvMsg_UpdateDateTime(reply, "ts", &reply_time);
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
-                    "%s failed to send a reply to a client request: %s\n",
+                    "%s failed to timestamp a reply to a client request: %s\n",
                     program_name,
                     tibrvStatus_GetText(return_code));
             exit(1);
         }
 
-        /* Destroy our reply message to reclaim space. */
-        return_code = tibrvMsg_Destroy(request_reply);
+        /* Send a reply to the request message. */
+        return_code = tibrvTransport_SendReply(reply_transport, reply, message);
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
-                    "%s failed to destroy a reply to a client request: %s\n",
+                    "%s failed to send a reply to a client request: %s\n",
                     program_name,
                     tibrvStatus_GetText(return_code));
             exit(1);
@@ -300,7 +440,7 @@ requestCallback(tibrvEvent event,
         }
 
         /* Send the message back as aa reply to the request message. */
-        return_code = tibrvTransport_SendReply(transport, message, message);
+        return_code = tibrvTransport_SendReply(reply_transport, message, message);
         if (return_code != TIBRV_OK)
         {
             fprintf(stderr,
@@ -313,12 +453,31 @@ requestCallback(tibrvEvent event,
 
     /* Increment the count of processed request messages.  Display if appropriate. */
     requests++;
+
+    if (show_stats)
+    {
+        tibrv_f64 svc;
+
+        tibrvMsg_GetCurrentTime(&svc_stop);
+        svc = ((tibrv_f64)(svc_stop.sec - svc_start.sec)) +
+              ((tibrv_f64)(svc_stop.nsec - svc_start.nsec)) / 1.0e9;
+        svc_total += svc;
+        if (svc > svc_max)
+            svc_max = svc;
+    }
+
     if (status_frq > 0) {
         if ((requests/status_frq)*status_frq == requests)
         {
             tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
             fprintf(stdout,"%s: %d client requests processed\n",
                     gmtTime, requests);
+            if (show_stats)
+                fprintf(stdout,
+                        "%s: callback service time avg %.1f usec, max %.1f usec\n",
+                        gmtTime,
+                        (svc_total / requests) * 1.0e6,
+                        svc_max * 1.0e6);
         }
     }
 
@@ -399,9 +558,63 @@ main(int    argc,
        communication, point-to-point messages will not go through a daemon. */
     tibrvTransport_CreateInbox(transport, inbox_subject, TIBRV_SUBJECT_MAX);
 
+    /* In worker mode, client requests go to a dedicated queue drained
+       by num_workers dispatcher threads; otherwise they share the
+       default queue with server searches. */
+    if (num_workers > 0)
+    {
+        tibrv_u32   w;
+        char        worker_name[32];
+
+        return_code = tibrvQueue_Create(&request_queue);
+        if (return_code != TIBRV_OK)
+        {
+            fprintf(stderr,
+                    "%s failed to create the request queue: %s\n",
+                    program_name,
+                    tibrvStatus_GetText(return_code));
+            exit(1);
+        }
+
+        for (w = 0; w < num_workers; w++)
+        {
+            /* Each worker replies on its own transport so reply I/O
+               is not serialized on one connection, and updates its own
+               reply message so the dispatcher threads never share a
+               tibrvMsg. */
+            return_code = tibrvTransport_Create(&workers[w].transport,
+                                                service, network, daemon);
+            if (return_code == TIBRV_OK)
+            {
+                sprintf(worker_name, "%s-worker-%d", "tibrvserver", w);
+                tibrvTransport_SetDescription(workers[w].transport,
+                                              worker_name);
+                return_code = tibrvDispatcher_Create(&workers[w].dispatcher,
+                                                     request_queue);
+                if (return_code == TIBRV_OK)
+                    tibrvDispatcher_SetName(workers[w].dispatcher,
+                                            worker_name);
+            }
+            if (return_code == TIBRV_OK)
+                return_code = createRequestReply(&workers[w].reply);
+            workers[w].used = TIBRV_FALSE;
+            if (return_code != TIBRV_OK)
+            {
+                fprintf(stderr,
+                        "%s failed to create worker %d: %s\n",
+                        program_name, w,
+                        tibrvStatus_GetText(return_code));
+                exit(1);
+            }
+            workers[w].served = 0;
+        }
+    }
+
     /* Create a listener for messages with our request subject. */
     return_code = tibrvEvent_CreateListener(&request_event,
-                                            TIBRV_DEFAULT_QUEUE,
+                                            (num_workers > 0) ?
+                                                request_queue :
+                                                TIBRV_DEFAULT_QUEUE,
                                             requestCallback,
                                             transport,
                                             inbox_subject,
@@ -439,6 +652,18 @@ main(int    argc,
         exit(1);
     }
 
+    /* Build the client request reply once for the single-threaded case;
+       in worker mode each worker built its own above. */
+    return_code = createRequestReply(&request_reply);
+    if (return_code != TIBRV_OK)
+    {
+        fprintf(stderr,
+                "%s failed to create a reply to a client request: %s\n",
+                program_name,
+                tibrvStatus_GetText(return_code));
+        exit(1);
+    }
+
     /* Display a server-ready message. */
     tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
     fprintf(stderr, "Listening for client searches on subject %s\n"
@@ -447,28 +672,66 @@ main(int    argc,
             search_subject, inbox_subject, SERVER_TIMEOUT, gmtTime, program_name);
 
 
-    /* If this server remains idle for more than the timeout value, exit. */
-    while (1 == 1)
+    /* If this server remains idle for more than the timeout value, exit.
+       In worker mode requests are processed on the worker threads, so a
+       timeout here only means the main queue was idle; keep running as
+       long as the workers made progress during the interval. */
     {
-        return_code = tibrvQueue_TimedDispatch(TIBRV_DEFAULT_QUEUE, SERVER_TIMEOUT);
-        if (return_code != TIBRV_OK)
+        tibrv_u32 last_requests = requests;
+
+        while (1 == 1)
         {
-            if (return_code != TIBRV_TIMEOUT)
-                fprintf(stderr, "%s: TimedDispatch received status %x: %s\n",
-                       program_name, return_code, tibrvStatus_GetText(return_code));
-            else
+            return_code = tibrvQueue_TimedDispatch(TIBRV_DEFAULT_QUEUE, SERVER_TIMEOUT);
+            if (return_code != TIBRV_OK)
+            {
+                if (return_code != TIBRV_TIMEOUT)
+                {
+                    fprintf(stderr, "%s: TimedDispatch received status %x: %s\n",
+                           program_name, return_code, tibrvStatus_GetText(return_code));
+                    break;
+                }
+                if (num_workers > 0 && requests != last_requests)
+                {
+                    last_requests = requests;
+                    continue;
+                }
                 fprintf(stderr, "%s: TimedDispatch received timeout\n", program_name);
-            break;
+                break;
+            }
         }
     }
 
     tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
     fprintf(stdout,"%s: %d client requests processed\n", gmtTime, requests);
 
+    if (show_stats && requests > 0)
+        fprintf(stdout, "callback service time avg %.1f usec, max %.1f usec\n",
+                (svc_total / requests) * 1.0e6, svc_max * 1.0e6);
+
+    if (num_workers > 0)
+    {
+        tibrv_u32 w;
+        for (w = 0; w < num_workers; w++)
+            fprintf(stdout, "  worker %d served %d requests\n",
+                    w, workers[w].served);
+    }
+
     /* Destroy our Tibrv objects and close the Tibrv machinery. */
     tibrvMsg_Destroy(search_reply);
+    tibrvMsg_Destroy(request_reply);
     tibrvEvent_Destroy(search_event);
     tibrvEvent_Destroy(request_event);
+    if (num_workers > 0)
+    {
+        tibrv_u32 w;
+        for (w = 0; w < num_workers; w++)
+        {
+            tibrvDispatcher_Destroy(workers[w].dispatcher);
+            tibrvMsg_Destroy(workers[w].reply);
+            tibrvTransport_Destroy(workers[w].transport);
+        }
+        tibrvQueue_Destroy(request_queue);
+    }
     tibrvTransport_Destroy(transport);
     tibrv_Close();
 
@@ -26,6 +26,11 @@
  *                                  counts -- if non-zero, a message is
  *                                  printed every <n> messages sent or
  *                                  received.
+ *   window       0                 optional number of requests kept in
+ *                                  flight on the circuit -- if non-zero,
+ *                                  the first <n> requests are sent up
+ *                                  front and each response clocks out
+ *                                  the next request.  Implies interval 0.
  *   requests     10000             number of client requests to send
  *
  * Example:
@@ -105,8 +110,11 @@ typedef enum  {
  */
 typedef struct vcStruct {
     vcState         vc_state;           /* our own state of the VC */
-    unsigned int    msgs_in;
+    unsigned int    msgs_in;            /* records received, not
+                                           messages; a batching server
+                                           packs several per message */
     unsigned int    msgs_out;
+    unsigned int    batches_in;         /* batched replies received */
     tibrvEvent      vc_disconnect_event;
     tibrvEvent      vc_msg_event;
     tibrvTransport  vc_transport;       /* the VC transport we create */
@@ -123,6 +131,8 @@ static tibrvEvent       timer_event;
 static tibrv_u32        requests = DEFAULT_REQUESTS;
 static unsigned int     status_frq = DEFAULT_STATUS_FRQ;
 static tibrv_f64        interval = DEFAULT_INTERVAL;
+static tibrv_u32        window = 0;     /* requests kept in flight;
+                                           0 = send all up front */
 
 static int              exit_status = 1;
 
@@ -139,7 +149,8 @@ usage(void)
 {
     fprintf(stderr,"tibrvvcclient  [-service service] [-network network]\n");
     fprintf(stderr,"               [-daemon daemon]   [-interval <secs>]\n");
-    fprintf(stderr,"               [-status <#msgs>]  <number of requests>\n");
+    fprintf(stderr,"               [-status <#msgs>]  [-window <#msgs>]\n");
+    fprintf(stderr,"               <number of requests>\n");
     exit(1);
 }
 
@@ -218,6 +229,11 @@ getParameters(int           argc,
             *status_frq = (tibrv_u32) atol(argv[i+1]);
             i += 2;
         }
+        else if (strcmp(argv[i], "-window") == 0)
+        {
+            window = (tibrv_u32) atol(argv[i+1]);
+            i += 2;
+        }
         else
         {
             usage();
@@ -447,8 +463,40 @@ serverResponse(
     void*       closure)
 {
     vcRec*      vc = (vcRec*)closure;
+    tibrv_u32   records = 1;
+    tibrv_u32   count = 0;
+    tibrv_u32   r;
+
+    /* A batching server (tibrvvcserver -batch) packs several results
+       into one message and marks it with a record count; unpack it.
+       A plain reply carries a single "sum" and no count. */
+    if (tibrvMsg_GetU32(msg, "count", &count) == TIBRV_OK && count > 0)
+    {
+        records = count;
+        vc->batches_in++;
+    }
+
+    vc->msgs_in += records;
 
-    vc->msgs_in++;
+    /* In windowed mode each response record clocks out the next
+       request, so <window> requests stay in flight on the circuit.
+       All sends after the initial window happen here, on the
+       dispatcher thread. */
+    for (r = 0; r < records && window > 0 && vc->msgs_out < requests; r++)
+    {
+        tibrv_status    return_code;
+
+        set_msg_data();
+        return_code = tibrvTransport_Send(vc->vc_transport,
+                                          client_request);
+        if (return_code != TIBRV_OK)
+        {
+            fprintf(stderr, "%s failed to send a client request: %s\n",
+                    program_name, tibrvStatus_GetText(return_code));
+            exit(1);
+        }
+        vc->msgs_out++;
+    }
     /* Report message count every <status_frq> messages received, after all our requests
      * have been sent.  While sending, we report every <status_frq> messages sent.*/
     if (vc->msgs_out == requests && status_frq > 0) {
@@ -593,6 +641,7 @@ main(int argc, char** argv)
     vc->vc_state = initializing;
     vc->msgs_in = 0;
     vc->msgs_out = 0;
+    vc->batches_in = 0;
 
     /* next: create a vc connection.  Exit if the connection is not
      * accepted by a server. */
@@ -665,13 +714,21 @@ main(int argc, char** argv)
     /*
      *  Start a dispatcher thread to dispatch responses while the
      *  main thread is still sending.  No point in waiting.
+     *
+     *  In windowed mode the thread is started only after the window
+     *  has been primed, so that every send after the initial window
+     *  happens on the dispatcher thread in serverResponse and the two
+     *  threads never touch the request message at the same time.
      */
-    return_code = tibrvDispatcher_Create(&response_thread, TIBRV_DEFAULT_QUEUE);
-    if (return_code != TIBRV_OK)
+    if (window == 0)
     {
-        fprintf(stderr, "failed to create response dispatcher--%s\n",
-                tibrvStatus_GetText(return_code));
-        exit(1);
+        return_code = tibrvDispatcher_Create(&response_thread, TIBRV_DEFAULT_QUEUE);
+        if (return_code != TIBRV_OK)
+        {
+            fprintf(stderr, "failed to create response dispatcher--%s\n",
+                    tibrvStatus_GetText(return_code));
+            exit(1);
+        }
     }
 
     /* Because this is only a test, we will repeatedly send the same request
@@ -717,9 +774,21 @@ main(int argc, char** argv)
     tibrvMsg_GetCurrentTime(&date_time_start);
     time_start = date_time_start.sec + (date_time_start.nsec / 1000000000.0);
 
+    /* Windowed mode paces itself off responses; an interval timer
+       would fight with it. */
+    if (window > 0)
+        interval = 0;
+
     if (interval == 0)
     {
-        for (i = 0; i < requests; i++)
+        tibrv_u32 to_send = requests;
+
+        /* In windowed mode only prime the circuit with the first
+           <window> requests; serverResponse sends the rest. */
+        if (window > 0 && window < requests)
+            to_send = window;
+
+        for (i = 0; i < to_send; i++)
         {
             /* Send a request message to the server. */
             set_msg_data();
@@ -744,10 +813,29 @@ main(int argc, char** argv)
             }
         }
 
-        /* Report the number of messages sent and number received while sending. */
-        fprintf(stdout,
-                "%d request messages sent.  %d messages received while sending.\n",
-                vc->msgs_out, vc->msgs_in);
+        if (window > 0)
+        {
+            fprintf(stdout, "Primed circuit with %d of %d requests.\n",
+                    vc->msgs_out, requests);
+
+            /* Now start dispatching responses; each one sends the
+               next request until all have gone out. */
+            return_code = tibrvDispatcher_Create(&response_thread,
+                                                 TIBRV_DEFAULT_QUEUE);
+            if (return_code != TIBRV_OK)
+            {
+                fprintf(stderr, "failed to create response dispatcher--%s\n",
+                        tibrvStatus_GetText(return_code));
+                exit(1);
+            }
+        }
+        else
+        {
+            /* Report the number of messages sent and number received while sending. */
+            fprintf(stdout,
+                    "%d request messages sent.  %d messages received while sending.\n",
+                    vc->msgs_out, vc->msgs_in);
+        }
     } else {
         /* Create a timer.  We will send a message each time we execute the callback
            until all the requests have been sent. */
@@ -782,6 +870,19 @@ main(int argc, char** argv)
         fprintf(stdout,
                 "This result implies an effective rate of %.1f requests/second.\n",
                 ((tibrv_f64) requests / elapsed));
+        /* One line per run in a fixed format, so sweeps over window
+           sizes can be tabulated directly. */
+        if (window > 0)
+            fprintf(stdout, "window=%d requests=%d rate=%.1f\n",
+                    window, requests, ((tibrv_f64) requests / elapsed));
+        /* Likewise for sweeps over server batch sizes: one line with
+           the achieved batching and the record rate. */
+        if (vc->batches_in > 0)
+            fprintf(stdout,
+                    "batches=%d avg_records=%.1f records_per_sec=%.1f\n",
+                    vc->batches_in,
+                    ((tibrv_f64) vc->msgs_in / vc->batches_in),
+                    ((tibrv_f64) vc->msgs_in / elapsed));
         exit_status = 0;
     }
     else
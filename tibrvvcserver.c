@@ -13,18 +13,26 @@
  * are used.  For information on default values for the transport
  * parameters, please see the TIBCO Rendezvous Concepts manual.
  *
- * The user may specify the number of threads, and a status display
- * frequency value.  The following defaults are used.
- *   threads        1       a single dispatcher thread
+ * Each accepted circuit gets its own queue and its own dispatcher
+ * thread, so several concurrent circuits proceed independently and a
+ * slow client never stalls the others.
+ *
+ * The user may specify response batching parameters, and a status
+ * display frequency value.  The following defaults are used.
+ *   batch          0       if non-zero, accumulate up to <n> results
+ *                          and send them as one multi-record reply
+ *                          instead of one reply per request
+ *   linger         5       milliseconds a partial batch may wait
+ *                          before it is flushed
  *   status         0       optional frequency of status display
  *                          counts -- if non-zero, a message is
  *                          printed every <n> messages sent or
  *                          received.
  * Example:
  *
- * Set up a vc server using service 7725, the loopback adapter, a daemon listening
- * on tcp:7505, and running 5 dispatcher threads.
- *   tibrvvcserver -service 7725 -network 127.0.0.1 -daemon 7505 -threads 5
+ * Set up a vc server using service 7725, the loopback adapter, a daemon
+ * listening on tcp:7505, batching up to 64 results per reply.
+ *   tibrvvcserver -service 7725 -network 127.0.0.1 -daemon 7505 -batch 64
  *
  * Use an ephemeral port for direct communication, specify a daemon host and
  * port to prevent autostarting a daemon, with status every 1000 requests.
@@ -71,16 +79,23 @@
                                                5 minutes of inactivity. */
 
 
-#define VC_THREAD_MAX       5                  /* The maximum number of threads to
-                                               dispatch off of a server dispatch
-                                               queue group.  This is a 'hook' to
-                                               allow the specification of the max
-                                               number of threads on the command
-                                               line. */
+#define BATCH_MAX           1024               /* Upper bound on -batch; also
+                                               sizes the per-circuit result
+                                               accumulator. */
+
+#define DEFAULT_LINGER      0.005              /* Seconds a partial batch may
+                                               wait before it is flushed. */
+
+#define REAP_INTERVAL       0.01               /* Seconds between checks that a
+                                               disconnected circuit's queue has
+                                               drained before it is torn down. */
 
 
 static char*                program_name;
 static unsigned int         status_frq = DEFAULT_STATUS_FRQ;
+static tibrv_u32            batch_size = 0;    /* results per reply; 0 sends
+                                               one reply per request */
+static tibrv_f64            linger_sec = DEFAULT_LINGER;
 char                        localTime[TIBRVMSG_DATETIME_STRING_SIZE];
 char                        gmtTime[TIBRVMSG_DATETIME_STRING_SIZE];
 
@@ -95,8 +110,8 @@ typedef struct serverStruct {
     tibrvTransport      server_transport;   /* for search requests */
     tibrvEvent          search_event;       /* eventId for searches */
     unsigned int        vc_count;
-    tibrvQueueGroup     vc_queues;          /* what we dispatch the VCs off of */
-    tibrvDispatcher     vc_dispatchers[VC_THREAD_MAX];  /* the dispatch threads */
+    unsigned int        vc_accepted;        /* circuits accepted so far;
+                                            names the dispatchers */
     char                server_name[TIBRV_SUBJECT_MAX]; /* a char identifier */
     char                search_subject[TIBRV_SUBJECT_MAX];
 } serverRec, *serverPtr;
@@ -126,12 +141,26 @@ typedef struct vcStruct {
                                         the 'owner' of this VC */
     vcState         vc_state;           /* our own state of the VC */
     unsigned int    msgs_in;
-    unsigned int    msgs_out;
+    unsigned int    msgs_out;           /* results sent (records, not
+                                        batches) */
+    unsigned int    batches_out;        /* batched replies sent */
+    unsigned int    max_backlog;        /* deepest request backlog seen
+                                        on vc_queue */
     tibrvEvent      vc_disconnect_event;
     tibrvEvent      vc_msg_event;
     tibrvEvent      vc_inbox_event;
+    tibrvEvent      vc_batch_timer;     /* flushes a lingering batch */
+    tibrvEvent      vc_reap_timer;      /* tears the circuit down once
+                                        its queue has drained */
     tibrvTransport  vc_transport;       /* the VC transport we create */
     tibrvQueue      vc_queue;           /* the incoming queue for work on this VC */
+    tibrvDispatcher vc_dispatcher;      /* this circuit's own dispatch
+                                        thread */
+    tibrvMsg        batch_msg;          /* reusable multi-record reply */
+    tibrv_u32       batch_count;        /* results accumulated so far */
+    tibrv_u32       batch_sums[BATCH_MAX];
+    char            batch_reply[TIBRV_SUBJECT_MAX]; /* where batches go;
+                                        captured from the first request */
     char            vc_inbox[TIBRV_SUBJECT_MAX];
     const char*     connect_subject;    /* what we need to send back in response
                                         to queries that uniquely identifies this
@@ -156,8 +185,8 @@ void
 usage(void)
 {
     fprintf(stderr, "usage: tibrvvcserver [-service <service>] [-network <network>]\n");
-    fprintf(stderr, "                     [-daemon  <daemon>]  [-threads <#threads>]\n");
-    fprintf(stderr, "                     [-status  <#msgs>]\n");
+    fprintf(stderr, "                     [-daemon  <daemon>]  [-batch <#results>]\n");
+    fprintf(stderr, "                     [-linger  <msecs>]   [-status <#msgs>]\n");
     exit(1);
 }
 
@@ -170,7 +199,6 @@ getParameters(int       argc,
               char**    serviceStr,
               char**    networkStr,
               char**    daemonStr,
-              unsigned int* threads,
               unsigned int* status_frq)
 {
     char*               progptr;
@@ -222,9 +250,22 @@ getParameters(int       argc,
             *daemonStr = argv[i + 1];
             i += 2;
         }
-        else if (strcmp(argv[i], "-threads") == 0)
+        else if (strcmp(argv[i], "-batch") == 0)
+        {
+            batch_size = (tibrv_u32) atoi(argv[i + 1]);
+            if (batch_size > BATCH_MAX)
+            {
+                fprintf(stderr, "%s: maximum batch is %d - using %d\n",
+                        program_name, BATCH_MAX, BATCH_MAX);
+                batch_size = BATCH_MAX;
+            }
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-linger") == 0)
         {
-            *threads = atoi(argv[i + 1]);
+            linger_sec = atof(argv[i + 1]) / 1000.0;
+            if (linger_sec <= 0.0)
+                linger_sec = DEFAULT_LINGER;
             i += 2;
         }
         else if (strcmp(argv[i], "-status") == 0)
@@ -265,9 +306,62 @@ vcControlInboxCallback(tibrvEvent event,
 
 
 
+/*
+ * Send the accumulated results as one multi-record message.  The
+ * batch, the timer that flushes it and the request callback all live
+ * on this circuit's queue and are served by this circuit's single
+ * dispatcher, so no locking is needed around the batch state.
+ */
+static void
+flushBatch(vcRec* vc)
+{
+    tibrv_status    return_code;
+
+    if (vc->batch_count == 0)
+        return;
+
+    return_code = tibrvMsg_UpdateU32Array(vc->batch_msg, "sums",
+                                          vc->batch_sums, vc->batch_count);
+    if (return_code == TIBRV_OK)
+        return_code = tibrvMsg_UpdateU32(vc->batch_msg, "count",
+                                         vc->batch_count);
+    if (return_code == TIBRV_OK)
+        return_code = tibrvMsg_SetSendSubject(vc->batch_msg,
+                                              vc->batch_reply);
+    if (return_code == TIBRV_OK)
+        return_code = tibrvTransport_Send(vc->vc_transport, vc->batch_msg);
+
+    if (return_code != TIBRV_OK)
+    {
+        fprintf(stderr,
+                "%s failed to send a batched reply: %s\n",
+                program_name,
+                tibrvStatus_GetText(return_code));
+        exit(1);
+    }
+
+    vc->msgs_out += vc->batch_count;
+    vc->batches_out++;
+    vc->batch_count = 0;
+}
+
+
+/*
+ * Linger timer: a partial batch never waits longer than roughly the
+ * linger interval for more results to arrive.
+ */
+static void
+batchTimerCallback(tibrvEvent event,
+                   tibrvMsg   message,
+                   void*      closure)
+{
+    flushBatch((vcRec*)closure);
+}
+
+
 /* This callback is executed when a client request is received.  It adds the
-   values in the request, puts the result in a message, and sends it as
-   a reply.  */
+   values in the request and either replies immediately or, when batching
+   is on, accumulates the result until the batch fills or lingers out.  */
 
 static void
 requestCallback(tibrvEvent event,
@@ -277,10 +371,18 @@ requestCallback(tibrvEvent event,
     tibrv_status    return_code = TIBRV_OK;
     tibrvMsg        request_reply;
     tibrv_u32       x, y, sum;
+    unsigned int    queue_count = 0;
     vcRec*          vc = (vcRec*)closure;
 
     vc->msgs_in++;
 
+    /* Track the deepest request backlog seen on this circuit.  With a
+       pipelining client (tibrvvcclient -window) this shows how far the
+       request stream runs ahead of the dispatch threads. */
+    tibrvQueue_GetCount(vc->vc_queue, &queue_count);
+    if (queue_count > vc->max_backlog)
+        vc->max_backlog = queue_count;
+
     /* Get the values in field "x" */
     return_code = tibrvMsg_GetU32(message, "x", &x);;
     if (return_code != TIBRV_OK)
@@ -307,7 +409,31 @@ requestCallback(tibrvEvent event,
     sum = x + y;
 
 
-    if (new_msg)
+    if (batch_size > 0)
+    {
+        /* All requests on a circuit carry the same reply subject, so
+           capture it once and address every batch there. */
+        if (vc->batch_reply[0] == '\0')
+        {
+            const char* reply_subject = NULL;
+
+            return_code = tibrvMsg_GetReplySubject(message, &reply_subject);
+            if (return_code != TIBRV_OK || reply_subject == NULL)
+            {
+                fprintf(stderr,
+                        "%s failed to get a reply subject for batching: %s\n",
+                        program_name,
+                        tibrvStatus_GetText(return_code));
+                exit(1);
+            }
+            strcpy(vc->batch_reply, reply_subject);
+        }
+
+        vc->batch_sums[vc->batch_count++] = sum;
+        if (vc->batch_count >= batch_size)
+            flushBatch(vc);
+    }
+    else if (new_msg)
     {
         /* Create a new reply message. */
         return_code = tibrvMsg_Create(&request_reply);
@@ -404,27 +530,20 @@ requestCallback(tibrvEvent event,
 
 
 
-/* The following routine destroys the VC structures */
+/* The following routine destroys the VC structures.  It must never run
+   on the circuit's own dispatcher thread: destroying the dispatcher
+   joins that thread, which would deadlock from inside one of its own
+   callbacks.  The reap timer below runs it on the default queue. */
 void
 destroyVC(vcRec*    vc)
 {
     unsigned int    queue_count = 0;
 
-    /* Remove VC queue from active circuit queue group - stops any
-    dispatching on the queue by removing it from the group.  You
-    could be more sophisticated here and let the queue count go to
-    zero before you destroy the queue.
-
-    A good way to do this would be to set a timer and posting
-    the timer event to the server dispatch queue; allowing the
-    dispatching threads to finish any outstanding processing on
-    the VC queue.  Once the timer callback determined that the
-    queue count is zero, we would be assured that there would be
-    no more pending work and the vc_queue could be removed from the
-    dispatching queue group and destroyed without the risk of any
-    lost data. */
-    tibrvQueueGroup_Remove(vc->server->vc_queues,
-        vc->vc_queue);
+    /* Destroy this circuit's dispatcher - stops any dispatching on
+    the queue.  The reap timer has already waited for the queue count
+    to reach zero, so no pending work is lost; the check here only
+    catches work that arrived after the last drain check. */
+    tibrvDispatcher_Destroy(vc->vc_dispatcher);
     tibrvQueue_GetCount(vc->vc_queue, &queue_count);
 
     if (queue_count != 0) {
@@ -435,12 +554,41 @@ destroyVC(vcRec*    vc)
 
     tibrvQueue_Destroy(vc->vc_queue);
 
+    if (vc->batch_msg != NULL)
+        tibrvMsg_Destroy(vc->batch_msg);
+
     /* free the VC structure */
     free(vc);
 }
 
 
 
+/*
+ *  Reap timer callback.  Runs on the default queue, i.e. the server
+ *  master thread.  The disconnect callback arms this timer instead of
+ *  tearing the circuit down itself, so the teardown - which joins the
+ *  circuit's dispatcher thread - happens from the master thread, and
+ *  only once the circuit's queue has drained.
+ */
+
+static void
+reapVcCallback(tibrvEvent event,
+               tibrvMsg   message,
+               void*      closure)
+{
+    vcRec*          vc = (vcRec*)closure;
+    unsigned int    queue_count = 0;
+
+    tibrvQueue_GetCount(vc->vc_queue, &queue_count);
+    if (queue_count != 0)
+        return;             /* still draining; check again next tick */
+
+    tibrvEvent_Destroy(vc->vc_reap_timer);
+    destroyVC(vc);
+}
+
+
+
 /*
  *  This callback is executed whenever we get a virtual circuit disconnect
  *  advisory.  It unwinds all of the virtual circuit setup logic that we
@@ -453,6 +601,7 @@ disconnectedVcCallback(tibrvEvent event,
                 void*       closure)
 {
     vcRec*          vc = (vcRec*)closure;
+    tibrv_status    return_code;
 
     /* destroy our transport */
     tibrvTransport_Destroy(vc->vc_transport);
@@ -462,8 +611,12 @@ disconnectedVcCallback(tibrvEvent event,
     if (vc->msgs_in != vc->msgs_out)
             tibrvQueue_TimedDispatch(vc->vc_queue, 0.0005);
 
-    fprintf(stderr, "%s: VC disconnected; in: %d, out: %d\n",
-            program_name, vc->msgs_in, vc->msgs_out);
+    fprintf(stderr, "%s: VC disconnected; in: %d, out: %d, max backlog: %d\n",
+            program_name, vc->msgs_in, vc->msgs_out, vc->max_backlog);
+    if (vc->batches_out > 0)
+        fprintf(stderr, "%s: %d results in %d batches (%.1f per batch)\n",
+                program_name, vc->msgs_out, vc->batches_out,
+                (tibrv_f64)vc->msgs_out / vc->batches_out);
     vc->vc_state = disconnected;
 
     fprintf(stderr,
@@ -475,9 +628,26 @@ disconnectedVcCallback(tibrvEvent event,
     tibrvEvent_Destroy(vc->vc_disconnect_event);
     tibrvEvent_Destroy(vc->vc_inbox_event);
     tibrvEvent_Destroy(vc->vc_msg_event);
-
-    /* wind down the VC data structures */
-    destroyVC(vc);
+    if (batch_size > 0)
+        tibrvEvent_Destroy(vc->vc_batch_timer);
+
+    /* Defer the structure teardown to the reap timer: destroying the
+    circuit's dispatcher joins its thread, so it must not happen from
+    any callback that thread might be running.  The timer waits for
+    the circuit's queue to drain and then destroys everything from
+    the master thread. */
+    return_code = tibrvEvent_CreateTimer(&vc->vc_reap_timer,
+                                         TIBRV_DEFAULT_QUEUE,
+                                         reapVcCallback,
+                                         REAP_INTERVAL,
+                                         (void*)vc);
+    if (return_code != TIBRV_OK)
+    {
+        fprintf(stderr,
+                "%s: failed to create the circuit reap timer: %s\n",
+                program_name,
+                tibrvStatus_GetText(return_code));
+    }
 
     return;
 }
@@ -506,6 +676,12 @@ createVC(serverRec* server,
     newVc->vc_state = initializing;
     newVc->msgs_in = 0;
     newVc->msgs_out = 0;
+    newVc->batches_out = 0;
+    newVc->max_backlog = 0;
+    newVc->batch_count = 0;
+    newVc->batch_msg = NULL;
+    newVc->batch_reply[0] = '\0';
+    newVc->vc_reap_timer = TIBRV_INVALID_ID;
     newVc->server = server;
 
     return_code = tibrvTransport_CreateAcceptVc(
@@ -616,6 +792,7 @@ searchCallback(tibrvEvent event,
     vcRec*      vc = NULL;
     serverRec*  server = (serverRec*)closure;
     tibrvMsg    search_reply;
+    char        disp_name[32];
 
     tibrv_status return_code = TIBRV_OK;
 
@@ -644,9 +821,9 @@ searchCallback(tibrvEvent event,
         exit(1);
     }
 
-    /* Register the listener on the VC event queue and add the
-    vc_queue event queue to the queue group that the server is
-    dispatching. */
+    /* Register the listener on the VC event queue and give this
+    circuit its own dispatcher thread, so concurrent circuits
+    proceed independently of each other. */
 
     return_code = tibrvEvent_CreateListener(&vc->vc_msg_event,
                                             vc->vc_queue,
@@ -664,8 +841,40 @@ searchCallback(tibrvEvent event,
         exit(1);
     }
 
-    tibrvQueueGroup_Add(server->vc_queues,
-                vc->vc_queue);
+    return_code = tibrvDispatcher_Create(&vc->vc_dispatcher,
+                                         vc->vc_queue);
+    if (return_code != TIBRV_OK)
+    {
+        fprintf(stderr,
+                "%s: failed to create circuit dispatcher: %s\n",
+                "searchCallback",
+                tibrvStatus_GetText(return_code));
+        exit(1);
+    }
+    sprintf(disp_name, "VC-%u", ++server->vc_accepted);
+    tibrvDispatcher_SetName(vc->vc_dispatcher, disp_name);
+
+    if (batch_size > 0)
+    {
+        /* The reusable batch message and the linger timer.  The timer
+        runs on the circuit's queue, so it shares the dispatcher with
+        the request callback and the batch state needs no lock. */
+        return_code = tibrvMsg_Create(&vc->batch_msg);
+        if (return_code == TIBRV_OK)
+            return_code = tibrvEvent_CreateTimer(&vc->vc_batch_timer,
+                                                 vc->vc_queue,
+                                                 batchTimerCallback,
+                                                 linger_sec,
+                                                 (void*)vc);
+        if (return_code != TIBRV_OK)
+        {
+            fprintf(stderr,
+                    "%s: failed to set up response batching: %s\n",
+                    "searchCallback",
+                    tibrvStatus_GetText(return_code));
+            exit(1);
+        }
+    }
 
 
     /* Add connect subject as reply inbox in the message and send it. */
@@ -745,17 +954,14 @@ main(int    argc,
     char*               networkStr = DEFAULT_NETWORK;
     char*               daemonStr  = DEFAULT_DAEMON;
 
-    char                disp_name[512]; /* string buffer */
     const char*         tibrv_version;
 
-    unsigned int        i, vcthreads=0;
-
     serverRec*          myServer;
 
 
     /* Parse the command line and set up the transport parameters. */
     getParameters(argc, argv, &serviceStr, &networkStr, &daemonStr,
-                  &vcthreads, &status_frq);
+                  &status_frq);
 
     /* The TIB/Rendezvous machinery needs to be started. */
     return_code = tibrv_Open();
@@ -773,6 +979,8 @@ main(int    argc,
     could just handle one VC at a time. */
 
     myServer = (serverRec*)malloc(sizeof(serverRec));
+    myServer->vc_count = 0;
+    myServer->vc_accepted = 0;
 
     /* Report Rendezvous version */
     tibrv_version = tibrv_Version();
@@ -810,47 +1018,13 @@ main(int    argc,
         exit(1);
     }
 
-    /* Now a queue group to hold the queues for the VCs that we
-    have open */
-
-    return_code = tibrvQueueGroup_Create(&myServer->vc_queues);
-    if (return_code != TIBRV_OK) {
-        fprintf(stderr,
-                "%s: failed to create queue group for VCs: %s\n",
-                program_name, tibrvStatus_GetText(return_code));
-    }
-
-    /* Finally, thread(s) dispatching off of the queue group.  We
-    can have a number of threads waiting on this one queue group
-    that will service all of the VC(s) and their individual
-    queues */
+    /* Circuit dispatchers are created per accepted circuit in
+    searchCallback; there is nothing more to set up here. */
 
-    if (vcthreads>VC_THREAD_MAX) {
-        vcthreads = VC_THREAD_MAX;
+    if (batch_size > 0)
         fprintf(stderr,
-                "%s: Maximum threads is %d - using %d\n",
-                program_name, VC_THREAD_MAX, VC_THREAD_MAX);
-    }
-
-    else if (vcthreads < 1) vcthreads = 1; /* need at least one */
-
-    for (i=0;i<vcthreads;i++) {
-        return_code = tibrvDispatcher_Create(
-            &myServer->vc_dispatchers[i],
-            myServer->vc_queues);
-
-        if (return_code != TIBRV_OK)
-        {
-            fprintf(stderr,
-                    "%s: failed to create dispatcher thread: %s\n", program_name,
-                    tibrvStatus_GetText(return_code));
-        }
-        sprintf(disp_name, "%s_%d", myServer->server_name, i);
-        return_code = tibrvDispatcher_SetName(
-            myServer->vc_dispatchers[i],
-            disp_name);
-    }
-
+                "%s: batching up to %d results per reply, linger %.1f ms\n",
+                program_name, batch_size, linger_sec * 1000.0);
 
     /* Display a server-ready message. */
     tibrvMsg_GetCurrentTimeString(localTime, gmtTime);
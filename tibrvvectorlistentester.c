@@ -33,9 +33,8 @@
  * This illustrates that it is very likely that vectorcallback_1 would get
  * vectors containing messages combined from the first two listeners.
  *
- * We added a second queue "waitQueue" that dispatches nothing but it is used to
- * wait 1.0 sec after each dispatch on default queue, giving time for more
- * messages to arrive so we can capture the behavior described above.
+ * The benchmark publish mode paces its sends with the shared rvutil
+ * token-bucket pacer (rvuPacer) when a rate is requested.
  */
 
 
@@ -45,13 +44,30 @@
 
 #include "tibrv/tibrv.h"
 
+#include "rvutil.h"
+
 #define MIN_PARMS       (3)
+
+#define BENCH_BATCH     (100)   /* messages handed to each Sendv call
+                                   in benchmark mode */
+
 static tibrv_u32                sendCount = 1;
+
+/* Benchmark mode parameters (see usage).  When benchCount is non-zero
+   the demo sequence above is replaced by a measured publish run against
+   the "bench.<n>" subjects that tibrvvectorlisten -bench listens on. */
+static tibrv_u32                benchCount    = 0;
+static tibrv_u32                benchMsgSize  = 0;
+static tibrv_u32                benchRate     = 0;
+static tibrv_u32                benchSubjects = 1;
+
 void
 usage(void)
 {
     fprintf(stderr,"tibrvvectorlistenertester   [-service service] [-network network] \n");
     fprintf(stderr,"                            [-daemon daemon] [-messages <messages>] \n");
+    fprintf(stderr,"                            [-bench <count>] [-msgsize <bytes>] \n");
+    fprintf(stderr,"                            [-rate <msgs/sec>] [-subjects <count>] \n");
     exit(1);
 }
 
@@ -97,6 +113,32 @@ get_InitParms(
             usage();
             sendCount = strtoul(argv[i], &end, 10);
         }
+        else if (strcmp(argv[i], "-bench") == 0)
+        {
+            if (++i >= argc)
+            usage();
+            benchCount = strtoul(argv[i], &end, 10);
+        }
+        else if (strcmp(argv[i], "-msgsize") == 0)
+        {
+            if (++i >= argc)
+            usage();
+            benchMsgSize = strtoul(argv[i], &end, 10);
+        }
+        else if (strcmp(argv[i], "-rate") == 0)
+        {
+            if (++i >= argc)
+            usage();
+            benchRate = strtoul(argv[i], &end, 10);
+        }
+        else if (strcmp(argv[i], "-subjects") == 0)
+        {
+            if (++i >= argc)
+            usage();
+            benchSubjects = strtoul(argv[i], &end, 10);
+            if (benchSubjects < 1)
+                benchSubjects = 1;
+        }
         else
         {
             usage();
@@ -106,6 +148,107 @@ get_InitParms(
     return( i );
 }
 
+/*********************************************************************/
+/* bench_publish:  Benchmark mode.  Builds BENCH_BATCH messages once */
+/*                 (cycling over benchSubjects "bench.<n>" subjects  */
+/*                 with an opaque payload of benchMsgSize bytes) and */
+/*                 republishes them with tibrvTransport_Sendv until  */
+/*                 benchCount messages are sent, paced by a token    */
+/*                 bucket when benchRate is given.                   */
+/*********************************************************************/
+static int
+bench_publish(tibrvTransport transport, char* progname)
+{
+    tibrv_status        err = TIBRV_OK;
+    tibrvMsg            batch[BENCH_BATCH];
+    rvuPacer            pacer;
+    char*               payload = NULL;
+    char                subject[TIBRV_SUBJECT_MAX];
+    tibrvMsgDateTime    start, now;
+    tibrv_f64           elapsed;
+    tibrv_u32           published = 0;
+    tibrv_u32           batchSize;
+    tibrv_u32           i;
+
+    if (benchMsgSize > 0)
+    {
+        payload = (char*)calloc(1, benchMsgSize);
+        if (payload == NULL)
+        {
+            fprintf(stderr, "%s: Failed to allocate %u byte payload\n",
+                    progname, benchMsgSize);
+            return(1);
+        }
+    }
+
+    /* Build the batch once; the publish loop only calls Sendv. */
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        err = tibrvMsg_Create(&batch[i]);
+        if (err == TIBRV_OK)
+        {
+            sprintf(subject, "bench.%u", i % benchSubjects);
+            err = tibrvMsg_SetSendSubject(batch[i], subject);
+        }
+        if (err == TIBRV_OK && benchMsgSize > 0)
+            err = tibrvMsg_AddOpaque(batch[i], "DATA",
+                                     payload, benchMsgSize);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: Failed to build benchmark batch: %s\n",
+                    progname, tibrvStatus_GetText(err));
+            return(1);
+        }
+    }
+
+    rvu_PacerInit(&pacer, (tibrv_f64)benchRate);
+
+    printf("Publishing %u messages of %u bytes over %u subjects",
+           benchCount, benchMsgSize, benchSubjects);
+    if (benchRate > 0)
+        printf(" at %u msgs/sec", benchRate);
+    printf(" (Sendv batches of %u)\n", (tibrv_u32)BENCH_BATCH);
+    fflush(stdout);
+
+    tibrvMsg_GetCurrentTime(&start);
+
+    while (published < benchCount)
+    {
+        batchSize = benchCount - published;
+        if (batchSize > BENCH_BATCH)
+            batchSize = BENCH_BATCH;
+
+        rvu_PacerAcquire(&pacer, (tibrv_f64)batchSize);
+
+        err = tibrvTransport_Sendv(transport, batch, batchSize);
+        if (err != TIBRV_OK)
+        {
+            fprintf(stderr, "%s: %s \n",
+                    progname, tibrvStatus_GetText(err));
+            break;
+        }
+        published += batchSize;
+    }
+
+    tibrvMsg_GetCurrentTime(&now);
+    elapsed = (tibrv_f64)(now.sec - start.sec) +
+              ((tibrv_f64)now.nsec - (tibrv_f64)start.nsec)*1e-9;
+    if (elapsed <= 0.0)
+        elapsed = 1e-9;
+
+    printf("Sent %u messages in %.3f seconds: %.0f msgs/sec, %.3f MB/sec\n",
+           published, elapsed, (tibrv_f64)published/elapsed,
+           ((tibrv_f64)published*(tibrv_f64)benchMsgSize)/(elapsed*1048576.0));
+    fflush(stdout);
+
+    rvu_PacerDestroy(&pacer);
+    for (i = 0; i < BENCH_BATCH; i++)
+        tibrvMsg_Destroy(batch[i]);
+    free(payload);
+
+    return(err == TIBRV_OK ? 0 : 1);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -154,6 +297,16 @@ main(int argc, char **argv)
 
     tibrvTransport_SetDescription(transport, progname);
 
+    /*
+     * Benchmark mode replaces the fixed demo sequence below.
+     */
+    if (benchCount > 0)
+    {
+        int rc = bench_publish(transport, progname);
+        tibrv_Close();
+        exit(rc);
+    }
+
     /*
      * Create messages
      */
@@ -15,11 +15,20 @@
 
 #include "tibrv/tibrv.h"
 
-/* field type */
-#define TIBRVMSG_CONTACT (222)
+/* field types */
+#define TIBRVMSG_CONTACT   (222)
+#define TIBRVMSG_TICKS_F64 (223)
+#define TIBRVMSG_TICKS_U32 (224)
 
 #define NAME_SIZE        (16)
 
+#define BENCH_DEFAULT_LEN   (100000)    /* elements per benchmark array */
+#define BENCH_DEFAULT_ITERS (100)       /* encode passes per variant    */
+#define BENCH_DECODE_CAP    (10000)     /* contact fields per message;
+                                           the per-field variant looks
+                                           fields up by name, which gets
+                                           quadratic past this */
+
 /* Custom data-type, a C struct */
 
 /*
@@ -120,6 +129,220 @@ myConvert_Contact(
     return TIBRV_OK;
 }
 
+/*
+ * Bulk tick-array types.  TIBRVMSG_TICKS_F64 and TIBRVMSG_TICKS_U32
+ * carry whole numeric arrays as one block.  On the wire the elements
+ * are big-endian; on little-endian hosts the encoder and decoder each
+ * make a single byte-swap pass over the block, and on big-endian
+ * hosts the block is copied as-is.  This avoids the per-element field
+ * machinery entirely -- see the -bench mode below for the difference.
+ */
+
+/* Runtime byte-order probe; RV wire data is big-endian. */
+static int
+host_is_little_endian(void)
+{
+    tibrv_u32 probe = 1;
+
+    return (*(tibrv_u8*)&probe == 1);
+}
+
+/*
+ * Byte-swap count 64-bit words from src to dst.  Each iteration is
+ * branch-free and independent of its neighbors, so optimizing
+ * compilers turn this loop into SIMD byte-shuffle instructions.
+ */
+static void
+swap64_block(
+    tibrv_u64*          dst,
+    const tibrv_u64*    src,
+    tibrv_u32           count)
+{
+    tibrv_u32   i;
+    tibrv_u64   v;
+
+    for (i = 0; i < count; i++)
+    {
+        v = src[i];
+        v = ((v & 0x00000000FFFFFFFFULL) << 32) | (v >> 32);
+        v = ((v & 0x0000FFFF0000FFFFULL) << 16) |
+            ((v >> 16) & 0x0000FFFF0000FFFFULL);
+        v = ((v & 0x00FF00FF00FF00FFULL) << 8) |
+            ((v >> 8) & 0x00FF00FF00FF00FFULL);
+        dst[i] = v;
+    }
+}
+
+/* As above for 32-bit words. */
+static void
+swap32_block(
+    tibrv_u32*          dst,
+    const tibrv_u32*    src,
+    tibrv_u32           count)
+{
+    tibrv_u32   i;
+    tibrv_u32   v;
+
+    for (i = 0; i < count; i++)
+    {
+        v = src[i];
+        v = (v << 16) | (v >> 16);
+        v = ((v & 0x00FF00FF) << 8) | ((v >> 8) & 0x00FF00FF);
+        dst[i] = v;
+    }
+}
+
+/* Shared encoder: one block copy, with a swap pass on little-endian
+   hosts.  elem_size selects the swap width. */
+static tibrv_status
+myEncode_Ticks(
+    char**              buffer,
+    tibrv_u32           mem_available,
+    tibrvMsgField*      field,
+    tibrv_u32           elem_size)
+{
+    void*       swapped;
+
+    if (!field->data.buf)
+        return TIBRV_INVALID_ARG;
+
+    if (mem_available < tibrvMsgData_ByteSize(field->size))
+        return TIBRV_NO_MEMORY;
+
+    if (!host_is_little_endian())
+    {
+        /* Already in wire order: pure block copy. */
+        tibrvMsgData_CopyBytes(buffer, field->data.buf, field->size);
+        return TIBRV_OK;
+    }
+
+    swapped = malloc(field->size);
+    if (!swapped)
+        return TIBRV_NO_MEMORY;
+
+    if (elem_size == sizeof(tibrv_u64))
+        swap64_block((tibrv_u64*)swapped,
+                     (const tibrv_u64*)field->data.buf, field->count);
+    else
+        swap32_block((tibrv_u32*)swapped,
+                     (const tibrv_u32*)field->data.buf, field->count);
+
+    tibrvMsgData_CopyBytes(buffer, swapped, field->size);
+    free(swapped);
+
+    return TIBRV_OK;
+}
+
+tibrv_status
+myEncode_TicksF64(
+    char**              buffer,
+    tibrv_u32           mem_available,
+    tibrvMsgField*      field)
+{
+    return myEncode_Ticks(buffer, mem_available, field,
+                          sizeof(tibrv_u64));
+}
+
+tibrv_status
+myEncode_TicksU32(
+    char**              buffer,
+    tibrv_u32           mem_available,
+    tibrvMsgField*      field)
+{
+    return myEncode_Ticks(buffer, mem_available, field,
+                          sizeof(tibrv_u32));
+}
+
+/* Shared decoder: one allocation and one swap (or copy) pass. */
+static tibrv_status
+myDecode_Ticks(
+    char**              buffer,
+    tibrvMsgField*      field,
+    tibrvMsgDataType*   data_type,
+    tibrv_u32           elem_size)
+{
+    void*       ticks;
+    const void* ticks_ptr;
+    tibrv_u32   size;
+
+    tibrvMsgData_GetBytes(buffer, &ticks_ptr, &size);
+    if (size == 0 || (size % elem_size) != 0)
+        return TIBRV_INVALID_ARG;
+
+    ticks = tibrvMsgData_Malloc(size);
+    if (!ticks)
+        return TIBRV_NO_MEMORY;
+
+    if (host_is_little_endian())
+    {
+        if (elem_size == sizeof(tibrv_u64))
+            swap64_block((tibrv_u64*)ticks, (const tibrv_u64*)ticks_ptr,
+                         size / elem_size);
+        else
+            swap32_block((tibrv_u32*)ticks, (const tibrv_u32*)ticks_ptr,
+                         size / elem_size);
+    }
+    else
+    {
+        memcpy(ticks, ticks_ptr, size);
+    }
+
+    field->data.buf = ticks;
+    field->size     = size;
+    field->count    = size / elem_size;
+
+    *data_type = tibrvMsgData_MallocBlock;
+
+    return TIBRV_OK;
+}
+
+tibrv_status
+myDecode_TicksF64(
+    char**              buffer,
+    tibrvMsgField*      field,
+    tibrvMsgDataType*   data_type)
+{
+    return myDecode_Ticks(buffer, field, data_type, sizeof(tibrv_u64));
+}
+
+tibrv_status
+myDecode_TicksU32(
+    char**              buffer,
+    tibrvMsgField*      field,
+    tibrvMsgDataType*   data_type)
+{
+    return myDecode_Ticks(buffer, field, data_type, sizeof(tibrv_u32));
+}
+
+/* Converter only reports the element count; printing a tick history
+   elementwise defeats the point of the type. */
+tibrv_status
+myConvert_Ticks(
+    tibrvMsgField*      field,
+    tibrv_u8            new_type,
+    tibrvMsgDataType*   data_type)
+{
+    char        str[64];
+
+    if (new_type != TIBRVMSG_STRING)
+        return TIBRV_CONVERSION_FAILED;
+
+    sprintf(str, "\"tick array, %u elements\"", field->count);
+
+    field->data.str = tibrvMsgData_Malloc(strlen(str)+1);
+    if ( field->data.str == NULL )
+        return TIBRV_NO_MEMORY;
+
+    strcpy((char*)field->data.str,str);
+
+    field->size = strlen(field->data.str)+1;
+    field->type = new_type;
+
+    *data_type = tibrvMsgData_MallocBlock;
+
+    return TIBRV_OK;
+}
+
 /* Convenience functions that allow intergration into the TIB/RV API */
 
 static tibrv_status
@@ -185,6 +408,351 @@ tibrvMsg_GetContact(
     return TIBRV_OK;
 }
 
+/*
+ * Arena-backed batch extraction.  Subscribers that receive thousands
+ * of contact fields per message spend their callback time in per-field
+ * GetField calls and the small allocation each decode makes.  The
+ * batch extractor walks the message once by index and copies every
+ * contact into a caller-supplied arena, returning one contiguous
+ * array of structs.  The arena is a bump allocator the caller resets
+ * between messages, so a steady-state consumer does no per-message
+ * heap allocation at all.  This is the decode-side twin of the bulk
+ * tick-array codec above.
+ */
+
+typedef struct {
+    char*       base;
+    tibrv_u32   size;
+    tibrv_u32   used;
+} contactArena;
+
+static void
+arena_init(
+    contactArena*   arena,
+    void*           memory,
+    tibrv_u32       size)
+{
+    arena->base = (char*)memory;
+    arena->size = size;
+    arena->used = 0;
+}
+
+static void*
+arena_alloc(
+    contactArena*   arena,
+    tibrv_u32       bytes)
+{
+    void*   block;
+
+    /* Keep allocations 8-byte aligned. */
+    bytes = (bytes + 7) & ~(tibrv_u32)7;
+
+    if (arena->used + bytes > arena->size)
+    return NULL;
+
+    block = arena->base + arena->used;
+    arena->used += bytes;
+    return block;
+}
+
+static tibrv_status
+tibrvMsg_GetAllContacts(
+    tibrvMsg        msg,
+    contactArena*   arena,
+    tibrvContact**  contacts,
+    tibrv_u32*      count)
+{
+    tibrvMsgField   f;
+    tibrvContact*   out;
+    tibrv_u32       num_fields;
+    tibrv_u32       reserved;
+    tibrv_u32       n = 0;
+    tibrv_u32       i;
+    tibrv_status    s;
+
+    s = tibrvMsg_GetNumFields(msg, &num_fields);
+    if (s != TIBRV_OK)
+    return s;
+
+    /* Reserve room for every field up front; the unused tail is
+       returned below.  This is safe because nothing else allocates
+       from the arena while we fill the array. */
+    reserved = num_fields * sizeof(tibrvContact);
+    out = (tibrvContact*)arena_alloc(arena, reserved);
+    if (!out)
+    return TIBRV_NO_MEMORY;
+
+    for (i = 0; i < num_fields; i++)
+    {
+    s = tibrvMsg_GetFieldByIndex(msg, &f, i);
+    if (s != TIBRV_OK)
+        return s;
+
+    if (f.type != TIBRVMSG_CONTACT)
+        continue;
+
+    memcpy(&out[n++], f.data.buf, sizeof(tibrvContact));
+    }
+
+    arena->used -= reserved - n * sizeof(tibrvContact);
+
+    *contacts = out;
+    *count = n;
+    return TIBRV_OK;
+}
+
+static tibrv_status
+tibrvMsg_AddTicksF64(
+    tibrvMsg        msg,
+    const char*     field_name,
+    tibrv_f64*      ticks,
+    tibrv_u32       count)
+{
+    tibrvMsgField f;
+
+    if (!ticks)
+    return TIBRV_INVALID_ARG;
+
+    f.name      = field_name;
+    f.id    = 0;
+    f.size      = count * sizeof(tibrv_f64);
+    f.count     = count;
+    f.type      = TIBRVMSG_TICKS_F64;
+    f.data.buf  = (void *)ticks;
+
+    return tibrvMsg_AddField(msg, &f);
+}
+
+/*
+ * Benchmark mode (-bench [length [iterations]]): encode a tick
+ * history of <length> tibrv_f64 values <iterations> times, once as
+ * individual F64 fields and once through the bulk tick-array codec,
+ * and report the per-pass cost of each.  A second section does the
+ * same on the decode side: extract every contact from a message of
+ * <length> contact fields, once through a per-field tibrvMsg_GetField
+ * loop and once through the arena-backed batch extractor.
+ */
+static tibrv_f64
+elapsed_seconds(
+    tibrvMsgDateTime*   start,
+    tibrvMsgDateTime*   stop)
+{
+    return (tibrv_f64)(stop->sec - start->sec) +
+           ((tibrv_f64)stop->nsec - (tibrv_f64)start->nsec)*1e-9;
+}
+
+static void
+run_bench(
+    const char*     progname,
+    tibrv_u32       length,
+    tibrv_u32       iters)
+{
+    tibrv_status        status;
+    tibrvMsg            msg;
+    tibrv_f64*          ticks;
+    const void*         bytes;
+    tibrvMsgDateTime    start;
+    tibrvMsgDateTime    stop;
+    tibrv_f64           perfield_secs;
+    tibrv_f64           bulk_secs;
+    tibrv_f64           mbytes;
+    char                name[32];
+    tibrv_u32           i;
+    tibrv_u32           iter;
+
+    ticks = (tibrv_f64*)malloc(length * sizeof(tibrv_f64));
+    if (!ticks)
+    {
+    fprintf(stderr, "%s: Failed to allocate %u element tick array\n",
+        progname, length);
+    exit(-1);
+    }
+    for (i = 0; i < length; i++)
+    ticks[i] = (tibrv_f64)i * 0.25;
+
+    mbytes = ((tibrv_f64)length * sizeof(tibrv_f64)) / 1048576.0;
+
+    printf("Encoding %u tibrv_f64 ticks (%.2f MB), %u passes per variant\n",
+       length, mbytes, iters);
+
+    /* Per-field variant: one F64 field per element. */
+    tibrvMsg_GetCurrentTime(&start);
+    for (iter = 0; iter < iters; iter++)
+    {
+    status = tibrvMsg_Create(&msg);
+    for (i = 0; i < length && status == TIBRV_OK; i++)
+    {
+        sprintf(name, "t%u", i);
+        status = tibrvMsg_AddF64(msg, name, ticks[i]);
+    }
+    status = status || tibrvMsg_GetAsBytes(msg, &bytes);
+    if (status != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Per-field encode failed: %s\n",
+            progname, tibrvStatus_GetText(status));
+        exit(-1);
+    }
+    tibrvMsg_Destroy(msg);
+    }
+    tibrvMsg_GetCurrentTime(&stop);
+    perfield_secs = elapsed_seconds(&start, &stop) / (tibrv_f64)iters;
+
+    /* Bulk variant: the whole array as one tick-array field. */
+    tibrvMsg_GetCurrentTime(&start);
+    for (iter = 0; iter < iters; iter++)
+    {
+    status = tibrvMsg_Create(&msg) ||
+         tibrvMsg_AddTicksF64(msg, "ticks", ticks, length) ||
+         tibrvMsg_GetAsBytes(msg, &bytes);
+    if (status != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Bulk encode failed: %s\n",
+            progname, tibrvStatus_GetText(status));
+        exit(-1);
+    }
+    tibrvMsg_Destroy(msg);
+    }
+    tibrvMsg_GetCurrentTime(&stop);
+    bulk_secs = elapsed_seconds(&start, &stop) / (tibrv_f64)iters;
+
+    printf("per-field: %.3f msec/pass (%.1f MB/sec)\n",
+       perfield_secs * 1000.0, mbytes / perfield_secs);
+    printf("bulk:      %.3f msec/pass (%.1f MB/sec)\n",
+       bulk_secs * 1000.0, mbytes / bulk_secs);
+    if (bulk_secs > 0.0)
+    printf("bulk codec is %.1fx faster\n", perfield_secs / bulk_secs);
+
+    free(ticks);
+}
+
+static void
+run_decode_bench(
+    const char*     progname,
+    tibrv_u32       length,
+    tibrv_u32       iters)
+{
+    tibrv_status        status;
+    tibrvMsg            src_msg;
+    tibrvMsg            msg;
+    tibrvContact        contact = {"Jane", "Doe", 0};
+    tibrvContact*       result;
+    tibrvContact*       dest;
+    tibrvContact*       batch;
+    contactArena        arena;
+    void*               arena_mem;
+    tibrv_u32           arena_size;
+    const void*         bytes;
+    tibrvMsgDateTime    start;
+    tibrvMsgDateTime    stop;
+    tibrv_f64           perfield_secs;
+    tibrv_f64           batch_secs;
+    tibrv_u32           found;
+    char                name[32];
+    tibrv_u32           i;
+    tibrv_u32           iter;
+
+    if (length > BENCH_DECODE_CAP)
+    length = BENCH_DECODE_CAP;
+
+    /* Build one source message of <length> contact fields and freeze
+       it to bytes; each timed pass decodes a fresh message from that
+       image so the decoder (and its per-field allocation) runs every
+       time, as it would for each message off the wire. */
+    status = tibrvMsg_Create(&src_msg);
+    for (i = 0; i < length && status == TIBRV_OK; i++)
+    {
+    sprintf(name, "c%u", i);
+    contact.age = (tibrv_u8)(i & 0x7F);
+    status = tibrvMsg_AddContact(src_msg, name, &contact);
+    }
+    status = status || tibrvMsg_GetAsBytes(src_msg, &bytes);
+    if (status != TIBRV_OK)
+    {
+    fprintf(stderr, "%s: Failed to build decode source message: %s\n",
+        progname, tibrvStatus_GetText(status));
+    exit(-1);
+    }
+
+    dest = (tibrvContact*)malloc(length * sizeof(tibrvContact));
+    arena_size = length * sizeof(tibrvContact) + 8;
+    arena_mem = malloc(arena_size);
+    if (!dest || !arena_mem)
+    {
+    fprintf(stderr, "%s: Failed to allocate %u contact buffers\n",
+        progname, length);
+    exit(-1);
+    }
+
+    printf("Decoding %u contact fields, %u passes per variant\n",
+       length, iters);
+
+    /* Per-field variant: one GetField by name per contact, copied out
+       one struct at a time. */
+    tibrvMsg_GetCurrentTime(&start);
+    for (iter = 0; iter < iters; iter++)
+    {
+    status = tibrvMsg_CreateFromBytes(&msg, bytes);
+    for (i = 0; i < length && status == TIBRV_OK; i++)
+    {
+        sprintf(name, "c%u", i);
+        status = tibrvMsg_GetContact(msg, name, &result);
+        if (status == TIBRV_OK)
+        dest[i] = *result;
+    }
+    if (status != TIBRV_OK)
+    {
+        fprintf(stderr, "%s: Per-field decode failed: %s\n",
+            progname, tibrvStatus_GetText(status));
+        exit(-1);
+    }
+    tibrvMsg_Destroy(msg);
+    }
+    tibrvMsg_GetCurrentTime(&stop);
+    perfield_secs = elapsed_seconds(&start, &stop) / (tibrv_f64)iters;
+
+    /* Batch variant: one pass by index into the arena; resetting the
+       arena is the whole per-message cleanup. */
+    tibrvMsg_GetCurrentTime(&start);
+    for (iter = 0; iter < iters; iter++)
+    {
+    arena_init(&arena, arena_mem, arena_size);
+    status = tibrvMsg_CreateFromBytes(&msg, bytes) ||
+         tibrvMsg_GetAllContacts(msg, &arena, &batch, &found);
+    if (status != TIBRV_OK || found != length)
+    {
+        fprintf(stderr, "%s: Batch decode failed: %s\n",
+            progname, tibrvStatus_GetText(status));
+        exit(-1);
+    }
+    tibrvMsg_Destroy(msg);
+    }
+    tibrvMsg_GetCurrentTime(&stop);
+    batch_secs = elapsed_seconds(&start, &stop) / (tibrv_f64)iters;
+
+    /* Spot-check the last extraction against the per-field copy. */
+    for (i = 0; i < length; i++)
+    {
+    if (batch[i].age != dest[i].age)
+    {
+        fprintf(stderr, "%s: Batch decode mismatch at contact %u\n",
+            progname, i);
+        exit(-1);
+    }
+    }
+
+    printf("per-field: %.3f msec/pass (%.0f contacts/sec)\n",
+       perfield_secs * 1000.0, (tibrv_f64)length / perfield_secs);
+    printf("batch:     %.3f msec/pass (%.0f contacts/sec)\n",
+       batch_secs * 1000.0, (tibrv_f64)length / batch_secs);
+    if (batch_secs > 0.0)
+    printf("batch extraction is %.1fx faster\n",
+           perfield_secs / batch_secs);
+
+    tibrvMsg_Destroy(src_msg);
+    free(arena_mem);
+    free(dest);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -200,6 +768,16 @@ main(int argc, char* argv[])
                   myDecode_Contact,
                   myConvert_Contact);
 
+    status |= tibrvMsg_SetHandlers(TIBRVMSG_TICKS_F64,
+                  myEncode_TicksF64,
+                  myDecode_TicksF64,
+                  myConvert_Ticks);
+
+    status |= tibrvMsg_SetHandlers(TIBRVMSG_TICKS_U32,
+                  myEncode_TicksU32,
+                  myDecode_TicksU32,
+                  myConvert_Ticks);
+
     if (status != TIBRV_OK)
     {
     fprintf(stderr, "%s: Unable to set custom encoder/decoder/conv: %s\n",
@@ -207,6 +785,18 @@ main(int argc, char* argv[])
     exit(-1);
     }
 
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+    {
+    tibrv_u32 length = (argc > 2) ? (tibrv_u32)strtoul(argv[2], NULL, 10)
+                      : BENCH_DEFAULT_LEN;
+    tibrv_u32 iters  = (argc > 3) ? (tibrv_u32)strtoul(argv[3], NULL, 10)
+                      : BENCH_DEFAULT_ITERS;
+
+    run_bench(argv[0], length, iters);
+    run_decode_bench(argv[0], length, iters);
+    return 0;
+    }
+
     status = tibrvMsg_Create(&msg);
 
     status |= tibrvMsg_AddContact(msg, "jane", &jane);